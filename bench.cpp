@@ -0,0 +1,259 @@
+// Benchmark de TGAImage: genera imagenes sinteticas (siempre las mismas) y mide las operaciones principales.
+// Cada medicion se imprime como una linea JSON en stdout, para poder comparar corridas con otras herramientas.
+//
+// Memoria de cada medicion: antes de empezar se reinicia el pico de RSS del proceso (/proc/self/clear_refs en
+// Linux) y se toma el RSS actual como base. peak_rss_kb es el pico durante esa medicion y rss_delta_kb lo que
+// ese pico supera a la base, o sea la memoria que uso la operacion. Donde no se puede reiniciar el pico,
+// peak_rss_kb es el pico de toda la corrida (getrusage) y rss_delta_kb es -1
+//
+// Uso: tgabench [--reps N] [--max-width N] [--dir carpeta]
+
+#include "tgaimage.h"
+#include "tgastats.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <sys/resource.h> // getrusage()
+
+namespace {
+
+// Da acceso a los metodos protegidos que tambien se quieren medir por separado
+class BenchImage : public TGAImage {
+public:
+    using TGAImage::TGAImage;
+
+    // Lee solo los datos RLE de un archivo (el header se lee aparte y no se mide)
+    bool decode_rle_file(const char* filename) {
+        std::ifstream in(filename, std::ios::binary);
+        TGA_Header header;
+        in.read((char*)&header, sizeof(header));
+        in.ignore((std::uint8_t)header.idlength);
+        allocate(header.width, header.height, header.bitsperpixel / 8);
+        return in.good() && load_rle_data(in, header.imagedescriptor);
+    }
+
+    bool encode_rle_file(const char* filename) {
+        std::ofstream out(filename, std::ios::binary);
+        return unload_rle_data(out);
+    }
+};
+
+struct Size {
+    int width;
+    int height;
+};
+
+const Size sizes[] = { { 256, 256 }, { 1024, 1024 }, { 1920, 1080 }, { 3840, 2160 }, { 7680, 4320 } };
+const char* const patterns[] = { "flat", "noise", "stripes", "checker" };
+const int formats[] = { TGAImage::GRAYSCALE, TGAImage::RGB, TGAImage::RGBA };
+
+// Generador pseudoaleatorio xorshift: con la misma semilla da siempre la misma imagen
+struct XorShift {
+    std::uint32_t state;
+    std::uint32_t next() {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+};
+
+void fill_pattern(BenchImage& img, const std::string& pattern) {
+    int w = img.get_width();
+    int h = img.get_height();
+    int bpp = img.get_bytespp();
+    unsigned char* data = img.buffer();
+    XorShift rng = { 0x12345678u };
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            std::uint32_t v;
+            if (pattern == "flat")
+                v = 0x80604020u;
+            else if (pattern == "noise")
+                v = rng.next();
+            else if (pattern == "stripes")
+                v = ((x / 32) % 2) ? 0xFFC08040u : 0x10203040u;
+            else
+                v = (((x / 8) + (y / 8)) % 2) ? 0xFFFFFFFFu : 0xFF0000FFu;
+            std::memcpy(data + ((std::size_t)y * w + x) * bpp, &v, bpp);
+        }
+    }
+}
+
+// Campo en KB de /proc/self/status (VmRSS, VmHWM), -1 si no existe
+long proc_status_kb(const char* field) {
+    std::ifstream in("/proc/self/status");
+    std::string line;
+    std::size_t len = std::strlen(field);
+    while (std::getline(in, line))
+        if (line.compare(0, len, field) == 0 && line.size() > len && line[len] == ':')
+            return std::atol(line.c_str() + len + 1);
+    return -1;
+}
+
+// Memoria de una medicion, ver el comentario del inicio
+struct RSSProbe {
+    long baseline_kb; // -1 si no se pudo reiniciar el pico
+};
+
+RSSProbe start_rss_probe() {
+    std::ofstream clear("/proc/self/clear_refs");
+    clear << "5"; // Reinicia VmHWM al RSS actual
+    clear.close();
+    long rss = proc_status_kb("VmRSS");
+    return { clear.good() && rss >= 0 ? rss : -1 };
+}
+
+long peak_rss_kb(const RSSProbe& probe) {
+    if (probe.baseline_kb >= 0) {
+        long hwm = proc_status_kb("VmHWM");
+        if (hwm >= 0)
+            return hwm;
+    }
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss; // En Linux ya esta en KB
+}
+
+long file_size(const std::string& filename) {
+    std::error_code ec;
+    return (long)std::filesystem::file_size(filename, ec);
+}
+
+// Ejecuta fn reps veces y retorna el mejor tiempo en segundos. probe empieza a medir la memoria
+template <class F> double best_time(int reps, F fn, RSSProbe& probe) {
+    probe = start_rss_probe();
+    double best = 1e30;
+    for (int r = 0; r < reps; r++) {
+        auto t0 = std::chrono::steady_clock::now();
+        fn();
+        auto t1 = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double>(t1 - t0).count());
+    }
+    return best;
+}
+
+void report(const char* op, const char* pattern, int bpp, int w, int h, double seconds, double ratio,
+            const RSSProbe& probe) {
+    double bytes = (double)w * h * bpp;
+    long peak = peak_rss_kb(probe);
+    long delta = probe.baseline_kb >= 0 ? std::max(0L, peak - probe.baseline_kb) : -1;
+    std::printf("{\"op\":\"%s\",\"pattern\":\"%s\",\"bpp\":%d,\"width\":%d,\"height\":%d,\"seconds\":%.6f,"
+                "\"mb_per_s\":%.2f,\"mpixels_per_s\":%.2f,\"compression_ratio\":%.4f,\"peak_rss_kb\":%ld,"
+                "\"rss_delta_kb\":%ld}\n",
+                op, pattern, bpp, w, h, seconds, bytes / seconds / 1e6, (double)w * h / seconds / 1e6, ratio, peak,
+                delta);
+    std::fflush(stdout);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int reps = 3;
+    int max_width = 7680;
+    std::string dir = std::filesystem::temp_directory_path().string();
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string arg = argv[i];
+        if (arg == "--reps")
+            reps = std::max(1, std::atoi(argv[i + 1]));
+        else if (arg == "--max-width")
+            max_width = std::atoi(argv[i + 1]);
+        else if (arg == "--dir")
+            dir = argv[i + 1];
+        else {
+            std::fprintf(stderr, "usage: %s [--reps N] [--max-width N] [--dir path]\n", argv[0]);
+            return 1;
+        }
+    }
+    tga_set_log_level(TGA_LOG_ERRORS); // Sin el "WxH/bpp" de cada lectura dentro de las mediciones
+    std::string raw_file = dir + "/tgabench_raw.tga";
+    std::string rle_file = dir + "/tgabench_rle.tga";
+    std::string rle_data = dir + "/tgabench_rle.bin";
+    std::string palette_file = dir + "/tgabench_palette.tga";
+
+    for (const Size& size : sizes) {
+        if (size.width > max_width)
+            continue;
+        int w = size.width;
+        int h = size.height;
+        for (int bpp : formats) {
+            for (const char* pattern : patterns) {
+                BenchImage img(w, h, bpp);
+                fill_pattern(img, pattern);
+                double raw_bytes = (double)w * h * bpp;
+                double t;
+                RSSProbe probe;
+
+                t = best_time(reps, [&]() { img.write_tga_file(raw_file.c_str(), false); }, probe);
+                report("write_raw", pattern, bpp, w, h, t, 1.0, probe);
+                t = best_time(reps, [&]() { img.write_tga_file(rle_file.c_str(), true); }, probe);
+                double ratio = raw_bytes / std::max(1L, file_size(rle_file));
+                report("write_rle", pattern, bpp, w, h, t, ratio, probe);
+
+                BenchImage loaded;
+                t = best_time(reps, [&]() { loaded.read_tga_file(raw_file.c_str()); }, probe);
+                report("read_raw", pattern, bpp, w, h, t, 1.0, probe);
+                t = best_time(reps, [&]() { loaded.read_tga_file(rle_file.c_str()); }, probe);
+                report("read_rle", pattern, bpp, w, h, t, ratio, probe);
+                // .tga color-mapped: los patrones sinteticos, salvo el ruido, tienen pocos colores
+                if (bpp != TGAImage::GRAYSCALE && std::strcmp(pattern, "noise") != 0 &&
+                    img.write_tga_file_palette(palette_file.c_str())) {
+                    t = best_time(reps, [&]() { loaded.read_tga_file(palette_file.c_str()); }, probe);
+                    report("read_palette", pattern, bpp, w, h, t, raw_bytes / std::max(1L, file_size(palette_file)),
+                           probe);
+                }
+
+                t = best_time(reps, [&]() { loaded.decode_rle_file(rle_file.c_str()); }, probe);
+                report("load_rle_data", pattern, bpp, w, h, t, ratio, probe);
+                t = best_time(reps, [&]() { img.encode_rle_file(rle_data.c_str()); }, probe);
+                report("unload_rle_data", pattern, bpp, w, h, t, raw_bytes / std::max(1L, file_size(rle_data)),
+                       probe);
+
+                t = best_time(reps, [&]() { img.flip_horizontally(); }, probe);
+                report("flip_horizontally", pattern, bpp, w, h, t, 1.0, probe);
+                t = best_time(reps, [&]() { img.flip_vertically(); }, probe);
+                report("flip_vertically", pattern, bpp, w, h, t, 1.0, probe);
+
+                // scale() cambia la imagen, se mide sobre copias hechas antes de empezar a contar
+                std::vector<TGAImage> copies(reps, img);
+                int r = 0;
+                t = best_time(reps, [&]() { copies[r++].scale(w / 2, h / 2); }, probe);
+                report("scale_half", pattern, bpp, w, h, t, 1.0, probe);
+                copies.clear();
+
+                // convert() tambien cambia la imagen: de gris a RGB, de RGB a RGBA y de RGBA a RGB
+                TGAImage::Format target = bpp == TGAImage::RGB ? TGAImage::RGBA : TGAImage::RGB;
+                copies.assign(reps, img);
+                r = 0;
+                t = best_time(reps, [&]() { copies[r++].convert(target); }, probe);
+                report(target == TGAImage::RGBA ? "convert_to_rgba" : "convert_to_rgb", pattern, bpp, w, h, t, 1.0,
+                       probe);
+                copies.clear();
+
+                // get()/set() pixel por pixel, como lo haria un bucle de shading
+                t = best_time(reps, [&]() {
+                    for (int y = 0; y < h; y++) {
+                        for (int x = 0; x < w; x++) {
+                            TGAColor c = img.get(x, y);
+                            c.val = ~c.val;
+                            img.set(x, y, c);
+                        }
+                    }
+                }, probe);
+                report("get_set", pattern, bpp, w, h, t, 1.0, probe);
+            }
+        }
+    }
+    std::remove(raw_file.c_str());
+    std::remove(rle_file.c_str());
+    std::remove(rle_data.c_str());
+    std::remove(palette_file.c_str());
+    return 0;
+}
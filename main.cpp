@@ -1,4 +1,5 @@
 #include "tgaimage.h"
+#include "tgaview.h"
 #include <fstream>
 #include <iostream>
 #include <string>
@@ -9,13 +10,18 @@ const TGAColor red = TGAColor(255, 0, 0, 255);
 int main(int argc, char** argv) {
 	TGAImage image(100, 100, TGAImage::Format::RGB);
 
-	for (int i = 0; i < image.get_height(); i++) {
-		for (int j = 0; j < image.get_width(); j++) {
+	// Se recorre la imagen fila por fila con una vista tipada, sin verificar limites en cada pixel
+	TGAImageViewRGB view(image);
+	const TGAImageViewRGB::Pixel w = TGAImageViewRGB::Pixel::from(white);
+	const TGAImageViewRGB::Pixel r = TGAImageViewRGB::Pixel::from(red);
+	for (int i = 0; i < view.get_height(); i++) {
+		TGAImageViewRGB::Pixel* row = view.row(i);
+		for (int j = 0; j < view.get_width(); j++) {
 			if (j % 2 == 0) {
-				image.set(j, i, (i % 2 != 0) ? white : red);
+				row[j] = (i % 2 != 0) ? w : r;
 			}
 			if (j % 2 != 0) {
-				image.set(j, i, (i % 2 != 0) ? red : white);
+				row[j] = (i % 2 != 0) ? r : w;
 			}
 		}
 	}
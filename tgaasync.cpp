@@ -0,0 +1,136 @@
+#include "tgaasync.h"
+#include "tgastats.h"
+#include "tgathreads.h"
+#include <fstream>
+
+#if defined(_WIN32)
+#define TGA_HAVE_FD_WRITE 0
+#else
+#define TGA_HAVE_FD_WRITE 1
+#include <cerrno>   // errno, EINTR
+#include <unistd.h> // ::write()
+#endif
+
+namespace {
+
+bool write_file(const std::string& filename, const std::vector<unsigned char>& bytes) {
+    std::ofstream out(filename, std::ios::binary);
+    if (!out.is_open()) {
+        tga_log() << "can't open file " << filename << "\n";
+        return false;
+    }
+    out.write((const char*)bytes.data(), bytes.size());
+    if (!out.good()) {
+        tga_log() << "can't dump the tga file\n";
+        return false;
+    }
+    tga_stats_add(TGA_STAT_FILES_WRITTEN, 1);
+    return true;
+}
+
+bool write_fd(int fd, const std::vector<unsigned char>& bytes) {
+#if TGA_HAVE_FD_WRITE
+    std::size_t done = 0;
+    while (done < bytes.size()) {
+        ssize_t n = ::write(fd, bytes.data() + done, bytes.size() - done);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            tga_log() << "can't dump the tga file\n";
+            return false;
+        }
+        done += n;
+    }
+    return true;
+#else
+    (void)fd;
+    (void)bytes;
+    tga_log() << "writing to a file descriptor is not supported on this platform\n";
+    return false;
+#endif
+}
+
+} // namespace
+
+TGAAsyncWriter::TGAAsyncWriter(int nthreads, std::size_t max_pending, bool rle)
+    : m_rle(rle), m_max_pending(max_pending ? max_pending : 1), m_next_seq(0), m_next_write(0), m_unfinished(0),
+      m_stop(false) {
+    nthreads = tga_resolve_threads(nthreads);
+    for (int i = 0; i < nthreads; i++)
+        m_workers.emplace_back([this]() { worker(); });
+}
+
+TGAAsyncWriter::~TGAAsyncWriter() {
+    wait();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_not_empty.notify_all();
+    for (std::thread& t : m_workers)
+        t.join();
+}
+
+std::future<bool> TGAAsyncWriter::submit(const char* filename, TGAImage&& img, TGAImage::Origin origin) {
+    return push(filename, -1, std::move(img), origin);
+}
+
+std::future<bool> TGAAsyncWriter::submit(int fd, TGAImage&& img, TGAImage::Origin origin) {
+    return push(std::string(), fd, std::move(img), origin);
+}
+
+std::future<bool> TGAAsyncWriter::push(std::string filename, int fd, TGAImage&& img, TGAImage::Origin origin) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_not_full.wait(lock, [this]() { return m_queue.size() < m_max_pending; }); // Backpressure
+    m_queue.push_back(Job{ m_next_seq++, std::move(filename), fd, std::move(img), origin, std::promise<bool>() });
+    std::future<bool> result = m_queue.back().done.get_future();
+    m_unfinished++;
+    lock.unlock();
+    m_not_empty.notify_one();
+    return result;
+}
+
+void TGAAsyncWriter::worker() {
+    std::vector<unsigned char> bytes; // Se reutiliza entre cuadros
+    for (;;) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_not_empty.wait(lock, [this]() { return m_stop || !m_queue.empty(); });
+        if (m_queue.empty())
+            return; // m_stop y no queda nada por hacer
+        Job job = std::move(m_queue.front());
+        m_queue.pop_front();
+        lock.unlock();
+        m_not_full.notify_one();
+
+        // La codificacion de varios cuadros se hace en paralelo, fuera del mutex
+        bool ok = job.image.write_tga_memory(bytes, m_rle, 1, job.origin);
+        job.image = TGAImage(); // El buffer vuelve a su allocator (p. ej. un TGAFramePool) antes de escribir
+
+        // La escritura respeta el orden de llegada. Los cuadros salen de la cola en orden, asi que el cuadro al
+        // que le toca siempre lo tiene algun hilo y la espera no se traba
+        lock.lock();
+        m_turn.wait(lock, [&]() { return m_next_write == job.seq; });
+        lock.unlock();
+        if (ok)
+            ok = job.filename.empty() ? write_fd(job.fd, bytes) : write_file(job.filename, bytes);
+
+        lock.lock();
+        m_next_write++;
+        bool idle = --m_unfinished == 0;
+        lock.unlock();
+        m_turn.notify_all();
+        if (idle)
+            m_idle.notify_all();
+        job.done.set_value(ok);
+    }
+}
+
+void TGAAsyncWriter::wait() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_idle.wait(lock, [this]() { return m_unfinished == 0; });
+}
+
+std::size_t TGAAsyncWriter::pending() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_unfinished;
+}
@@ -0,0 +1,67 @@
+#ifndef __TGAASYNC_H__
+#define __TGAASYNC_H__
+
+#include <condition_variable> // Para utilizar std::condition_variable
+#include <cstdint>
+#include <deque>
+#include <future> // Para utilizar std::future y std::promise
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "tgaimage.h"
+
+// Escritor de secuencias de cuadros en segundo plano: el hilo que renderiza entrega cada cuadro con submit()
+// (por movimiento, sin copiar los pixeles) y sigue con el siguiente mientras otros hilos codifican y escriben.
+// Los cuadros se codifican en paralelo pero se escriben estrictamente en el orden en que se entregaron, asi
+// el resultado es el mismo que escribiendolos uno por uno (importa sobre todo al escribir a un pipe).
+//
+// La cola es acotada: si ya hay max_pending cuadros esperando, submit() bloquea hasta que se libere un lugar.
+// Con imagenes reservadas con un TGAFramePool el buffer de cada cuadro vuelve al pool apenas se codifica,
+// asi con max_pending = 2 se tiene doble buffer sin reservas en el heap
+class TGAAsyncWriter {
+protected:
+	struct Job {
+		std::uint64_t seq;    // Orden de llegada, es el orden de escritura
+		std::string filename; // Archivo destino, o vacio si se escribe a fd
+		int fd;
+		TGAImage image;
+		TGAImage::Origin origin;
+		std::promise<bool> done;
+	};
+
+	bool m_rle;
+	std::size_t m_max_pending;
+	std::deque<Job> m_queue;
+	std::vector<std::thread> m_workers;
+	std::uint64_t m_next_seq;   // Numero que recibe el siguiente cuadro
+	std::uint64_t m_next_write; // Cuadro al que le toca escribirse
+	std::size_t m_unfinished;   // Cuadros entregados que todavia no se escribieron
+	bool m_stop;
+	mutable std::mutex m_mutex;
+	std::condition_variable m_not_empty; // Hay trabajo en la cola (o hay que terminar)
+	std::condition_variable m_not_full;  // Se libero un lugar en la cola
+	std::condition_variable m_turn;      // Cambio m_next_write
+	std::condition_variable m_idle;      // m_unfinished llego a 0
+
+	std::future<bool> push(std::string filename, int fd, TGAImage&& img, TGAImage::Origin origin);
+	void worker();
+
+public:
+	// nthreads: hilos que codifican (<= 0: todos los nucleos). max_pending: cuadros que pueden esperar en la cola
+	explicit TGAAsyncWriter(int nthreads = 2, std::size_t max_pending = 2, bool rle = true);
+	// Espera a que se escriban todos los cuadros entregados
+	~TGAAsyncWriter();
+	TGAAsyncWriter(const TGAAsyncWriter&) = delete;
+	TGAAsyncWriter& operator=(const TGAAsyncWriter&) = delete;
+
+	// Encola img para escribirla en filename; img queda vacia. El future indica si se pudo escribir
+	std::future<bool> submit(const char* filename, TGAImage&& img, TGAImage::Origin origin = TGAImage::TOP_LEFT);
+	// Igual, pero el .tga se escribe a continuacion en el descriptor fd (pipe, socket), que no se cierra
+	std::future<bool> submit(int fd, TGAImage&& img, TGAImage::Origin origin = TGAImage::TOP_LEFT);
+	// Bloquea hasta que se hayan escrito todos los cuadros entregados hasta ahora
+	void wait();
+	std::size_t pending() const; // Cuadros entregados que todavia no se escribieron
+};
+
+#endif //__TGAASYNC_H__
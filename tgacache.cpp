@@ -0,0 +1,173 @@
+#include "tgacache.h"
+#include "tgastats.h"
+#include <filesystem> // std::filesystem::last_write_time() y file_size()
+
+namespace {
+
+// Fecha de modificacion y tamanio del archivo, false si no existe
+bool file_stamp(const char* filename, std::int64_t& time, std::uint64_t& size) {
+    std::error_code ec;
+    auto t = std::filesystem::last_write_time(filename, ec);
+    if (ec)
+        return false;
+    size = std::filesystem::file_size(filename, ec);
+    if (ec)
+        return false;
+    time = (std::int64_t)t.time_since_epoch().count();
+    return true;
+}
+
+} // namespace
+
+TGATextureCache::TGATextureCache(std::size_t budget) : m_budget(budget), m_next_load_id(0), m_stats() {}
+
+TGATextureCache& TGATextureCache::global() {
+    static TGATextureCache cache;
+    return cache;
+}
+
+TGATextureCache::Handle TGATextureCache::load(const char* filename) {
+    std::int64_t time = 0;
+    std::uint64_t size = 0;
+    if (!file_stamp(filename, time, size)) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stats.failures++;
+        tga_log() << "can't open file " << filename << "\n";
+        return nullptr;
+    }
+    std::string key = filename;
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    auto it = m_entries.find(key);
+    if (it != m_entries.end() && it->second.file_time == time && it->second.file_size == size) {
+        Entry& e = it->second;
+        if (e.ready) {
+            m_stats.hits++;
+            m_lru.splice(m_lru.begin(), m_lru, e.lru); // Pasa al frente
+            return e.image.get();
+        }
+        // Otro hilo la esta decodificando: se espera su resultado sin tener el mutex
+        m_stats.shared++;
+        std::shared_future<Handle> pending = e.image;
+        lock.unlock();
+        return pending.get();
+    }
+    if (it != m_entries.end()) {
+        if (!it->second.ready) { // Se esta leyendo otra version del archivo: esta se lee sin guardarla
+            m_stats.misses++;
+            lock.unlock();
+            auto img = std::make_shared<TGAImage>();
+            return img->read_tga_file(filename) ? img : nullptr;
+        }
+        // El archivo cambio desde que se guardo
+        m_stats.bytes -= it->second.bytes;
+        m_lru.erase(it->second.lru);
+        m_entries.erase(it);
+    }
+
+    // Se registra la carga antes de decodificar, asi los demas pedidos de la misma textura la esperan
+    m_stats.misses++;
+    std::promise<Handle> promise;
+    Entry& e = m_entries[key];
+    e.file_time = time;
+    e.file_size = size;
+    e.image = promise.get_future().share();
+    e.ready = false;
+    e.load_id = m_next_load_id++;
+    e.bytes = 0;
+    std::uint64_t load_id = e.load_id;
+    lock.unlock();
+
+    // La entrada puede haberse borrado con erase() o clear() mientras tanto (y hasta haberse creado otra)
+    auto find_mine = [&]() {
+        it = m_entries.find(key);
+        return it != m_entries.end() && !it->second.ready && it->second.load_id == load_id;
+    };
+
+    std::shared_ptr<TGAImage> img;
+    Handle handle;
+    try {
+        img = std::make_shared<TGAImage>();
+        if (img->read_tga_file(filename))
+            handle = img;
+    } catch (...) { // Por ejemplo bad_alloc del allocator: los que esperan reciben la misma excepcion
+        lock.lock();
+        m_stats.failures++;
+        if (find_mine()) // Sin la entrada, el proximo load() vuelve a intentar
+            m_entries.erase(it);
+        lock.unlock();
+        promise.set_exception(std::current_exception());
+        throw;
+    }
+
+    lock.lock();
+    bool mine = find_mine();
+    if (!handle) {
+        m_stats.failures++;
+        if (mine)
+            m_entries.erase(it);
+    } else if (mine) {
+        Entry& done = it->second;
+        done.ready = true;
+        done.bytes = (std::size_t)img->get_width() * img->get_height() * img->get_bytespp();
+        m_lru.push_front(key);
+        done.lru = m_lru.begin();
+        m_stats.bytes += done.bytes;
+        evict();
+    }
+    lock.unlock();
+    promise.set_value(handle);
+    return handle;
+}
+
+void TGATextureCache::evict() {
+    while (m_stats.bytes > m_budget && !m_lru.empty()) {
+        auto it = m_entries.find(m_lru.back());
+        m_stats.bytes -= it->second.bytes;
+        m_stats.evictions++;
+        m_entries.erase(it);
+        m_lru.pop_back();
+    }
+}
+
+void TGATextureCache::erase(const char* filename) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_entries.find(filename);
+    if (it == m_entries.end())
+        return;
+    if (it->second.ready) {
+        m_stats.bytes -= it->second.bytes;
+        m_lru.erase(it->second.lru);
+    }
+    m_entries.erase(it); // Si se estaba decodificando, el hilo que la lee ya no la guarda
+}
+
+void TGATextureCache::clear() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_entries.clear();
+    m_lru.clear();
+    m_stats.bytes = 0;
+}
+
+void TGATextureCache::set_budget(std::size_t budget) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_budget = budget;
+    evict();
+}
+
+std::size_t TGATextureCache::get_budget() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_budget;
+}
+
+TGATextureCache::Stats TGATextureCache::stats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Stats s = m_stats;
+    s.entries = m_lru.size();
+    return s;
+}
+
+void TGATextureCache::reset_stats() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats.hits = m_stats.misses = m_stats.shared = m_stats.evictions = m_stats.failures = 0;
+}
@@ -0,0 +1,77 @@
+#ifndef __TGACACHE_H__
+#define __TGACACHE_H__
+
+#include <cstdint>
+#include <future> // Para utilizar std::shared_future
+#include <list>
+#include <memory> // Para utilizar std::shared_ptr
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "tgaimage.h"
+
+// Cache de texturas ya decodificadas, compartida por todos los hilos. La clave es la ruta del archivo junto
+// con su fecha de modificacion y su tamanio: si el archivo cambia se vuelve a leer. Cargar una textura que ya
+// esta en el cache cuesta una busqueda en la tabla (y leer la fecha y el tamanio del archivo).
+//
+// Las imagenes se entregan como handles de solo lectura; una imagen sigue viva mientras alguien tenga su
+// handle, aunque el cache ya la haya descartado. Cuando los pixeles guardados superan el presupuesto se
+// descartan las menos usadas recientemente (LRU). Si varios hilos piden a la vez la misma textura que todavia
+// no esta, solo uno la decodifica y los demas esperan su resultado
+class TGATextureCache {
+public:
+	typedef std::shared_ptr<const TGAImage> Handle;
+
+	struct Stats {
+		std::uint64_t hits;      // Texturas que ya estaban decodificadas
+		std::uint64_t misses;    // Texturas que hubo que decodificar
+		std::uint64_t shared;    // Pedidos que esperaron la decodificacion que ya hacia otro hilo
+		std::uint64_t evictions; // Texturas descartadas por el presupuesto
+		std::uint64_t failures;  // Archivos que no se pudieron leer
+		std::size_t entries;     // Texturas guardadas ahora
+		std::size_t bytes;       // Bytes de pixeles guardados ahora
+	};
+
+protected:
+	struct Entry {
+		std::int64_t file_time;
+		std::uint64_t file_size;
+		std::shared_future<Handle> image; // Listo cuando termina la decodificacion
+		bool ready;
+		std::uint64_t load_id; // Que llamada a load() la esta decodificando
+		std::size_t bytes;
+		std::list<std::string>::iterator lru; // Posicion en m_lru (solo si ready)
+	};
+
+	std::unordered_map<std::string, Entry> m_entries;
+	std::list<std::string> m_lru; // Rutas de las texturas listas, la mas usada recientemente al frente
+	std::size_t m_budget;
+	std::uint64_t m_next_load_id;
+	Stats m_stats;
+	mutable std::mutex m_mutex;
+
+	void evict(); // Descarta texturas hasta quedar dentro del presupuesto. Requiere m_mutex
+
+public:
+	// budget: bytes de pixeles que se pueden guardar
+	explicit TGATextureCache(std::size_t budget = (std::size_t)256 << 20);
+	TGATextureCache(const TGATextureCache&) = delete;
+	TGATextureCache& operator=(const TGATextureCache&) = delete;
+
+	// Cache para todo el proceso
+	static TGATextureCache& global();
+
+	// Textura decodificada de filename, o nullptr si no se pudo leer. Si la decodificacion lanza una excepcion
+	// (bad_alloc, por ejemplo), la reciben este pedido y los que la esperaban, y la textura no queda en el cache
+	Handle load(const char* filename);
+	// Descarta la textura de filename (los handles que ya se entregaron siguen siendo validos)
+	void erase(const char* filename);
+	void clear();
+
+	void set_budget(std::size_t budget);
+	std::size_t get_budget() const;
+	Stats stats() const;
+	void reset_stats();
+};
+
+#endif //__TGACACHE_H__
@@ -0,0 +1,449 @@
+// Conversion de muchos .tga a la vez: RLE <-> sin comprimir, orientacion, volteo y redimension.
+// Las etapas van en paralelo como una tuberia: hilos de lectura cargan los archivos en memoria, un pool de
+// hilos (con robo de trabajo) decodifica, transforma y codifica, y hilos de escritura guardan el resultado.
+// Asi el disco y los nucleos trabajan al mismo tiempo y un archivo grande no deja a los demas hilos sin trabajo.
+//
+// Uso: tgaconvert -o <carpeta> [opciones] <archivo.tga | carpeta>...
+
+#include "tgaimage.h"
+#include "tgaresample.h"
+#include "tgastats.h"
+#include "tgathreads.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+struct Options {
+    std::string out_dir;
+    bool rle = true;
+    TGAImage::Origin origin = TGAImage::TOP_LEFT;
+    bool flip_h = false;
+    bool flip_v = false;
+    int width = 0; // 0: sin redimensionar
+    int height = 0;
+    TGAFilter filter = TGA_FILTER_BICUBIC;
+    int format = 0;     // 0: el mismo formato de cada archivo
+    int threads = 0;    // Hilos de calculo, <= 0: todos los nucleos
+    int io_threads = 2; // Hilos de lectura y otros tantos de escritura
+};
+
+struct Task {
+    std::size_t id;
+    fs::path input;
+    fs::path output;
+    std::vector<unsigned char> bytes; // Contenido del archivo, y despues el archivo convertido
+    std::uint64_t pixels;
+};
+
+// Cola acotada entre dos etapas: push() bloquea si esta llena, pop() si esta vacia. close() indica que no
+// llegaran mas elementos
+class BoundedQueue {
+    std::deque<Task> m_items;
+    std::size_t m_capacity;
+    bool m_closed;
+    std::mutex m_mutex;
+    std::condition_variable m_changed;
+
+public:
+    explicit BoundedQueue(std::size_t capacity) : m_capacity(capacity), m_closed(false) {}
+
+    void push(Task&& t) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_changed.wait(lock, [this]() { return m_items.size() < m_capacity; });
+        m_items.push_back(std::move(t));
+        lock.unlock();
+        m_changed.notify_all();
+    }
+
+    bool pop(Task& t) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_changed.wait(lock, [this]() { return m_closed || !m_items.empty(); });
+        if (m_items.empty())
+            return false;
+        t = std::move(m_items.front());
+        m_items.pop_front();
+        lock.unlock();
+        m_changed.notify_all();
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed = true;
+        m_changed.notify_all();
+    }
+};
+
+// Pool de calculo con robo de trabajo: cada hilo tiene su propia cola, toma tareas del frente de la suya y,
+// si se queda sin trabajo, roba del final de la cola de otro hilo. Las tareas nuevas se reparten en ronda
+class StealingPool {
+    struct Worker {
+        std::deque<Task> tasks;
+        std::mutex mutex;
+    };
+    std::vector<Worker> m_workers;
+    std::atomic<std::size_t> m_next;  // Hilo que recibe la siguiente tarea
+    std::size_t m_capacity;           // Tareas en todas las colas a la vez
+    std::size_t m_count;              // Tareas en todas las colas ahora
+    bool m_closed;
+    std::mutex m_mutex;               // Protege m_count y m_closed
+    std::condition_variable m_changed;
+
+    bool try_take(std::size_t self, Task& t) {
+        for (std::size_t k = 0; k < m_workers.size(); k++) {
+            Worker& w = m_workers[(self + k) % m_workers.size()];
+            std::lock_guard<std::mutex> lock(w.mutex);
+            if (w.tasks.empty())
+                continue;
+            if (k == 0) { // Propia: del frente, en el orden en que llegaron
+                t = std::move(w.tasks.front());
+                w.tasks.pop_front();
+            } else { // Robada: del final, lo mas lejos posible de lo que esta por tomar el duenio
+                t = std::move(w.tasks.back());
+                w.tasks.pop_back();
+            }
+            return true;
+        }
+        return false;
+    }
+
+public:
+    StealingPool(int nworkers, std::size_t capacity)
+        : m_workers(nworkers), m_next(0), m_capacity(capacity), m_count(0), m_closed(false) {}
+
+    void push(Task&& t) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_changed.wait(lock, [this]() { return m_count < m_capacity; });
+            m_count++;
+        }
+        Worker& w = m_workers[m_next++ % m_workers.size()];
+        {
+            std::lock_guard<std::mutex> lock(w.mutex);
+            w.tasks.push_back(std::move(t));
+        }
+        m_changed.notify_all();
+    }
+
+    // Siguiente tarea para el hilo self, false cuando ya no quedan y no llegaran mas
+    bool pop(std::size_t self, Task& t) {
+        for (;;) {
+            if (try_take(self, t)) {
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    m_count--;
+                }
+                m_changed.notify_all();
+                return true;
+            }
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (m_count == 0 && m_closed)
+                return false;
+            // m_count se incrementa antes de encolar, asi que puede haber una tarea en camino: se reintenta
+            m_changed.wait(lock, [this]() { return m_count > 0 || m_closed; });
+        }
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed = true;
+        m_changed.notify_all();
+    }
+};
+
+bool is_tga(const fs::path& p) {
+    std::string ext = p.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+    return ext == ".tga";
+}
+
+// Agrega los .tga de arg (un archivo, o una carpeta recorrida recursivamente) con su ruta de salida
+void collect(const fs::path& arg, const fs::path& out_dir, std::vector<Task>& tasks) {
+    std::error_code ec;
+    if (fs::is_directory(arg, ec)) {
+        for (const fs::directory_entry& e : fs::recursive_directory_iterator(arg, ec)) {
+            if (e.is_regular_file(ec) && is_tga(e.path()))
+                tasks.push_back({ 0, e.path(), out_dir / fs::relative(e.path(), arg, ec), {}, 0 });
+        }
+    } else {
+        tasks.push_back({ 0, arg, out_dir / arg.filename(), {}, 0 });
+    }
+}
+
+// Dos entradas con la misma ruta de salida se pisarian en la etapa de escritura (por ejemplo a/x.tga y b/x.tga
+// pasados como archivos). Informa cada choque y retorna false si hay alguno
+bool check_outputs(const std::vector<Task>& tasks) {
+    std::map<fs::path, const Task*> outputs;
+    bool ok = true;
+    for (const Task& t : tasks) {
+        auto it = outputs.emplace(t.output.lexically_normal(), &t);
+        if (!it.second) {
+            std::fprintf(stderr, "%s and %s would both be written to %s\n", it.first->second->input.string().c_str(),
+                         t.input.string().c_str(), t.output.string().c_str());
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+bool read_bytes(const fs::path& p, std::vector<unsigned char>& bytes) {
+    std::ifstream in(p, std::ios::binary | std::ios::ate);
+    if (!in.is_open())
+        return false;
+    std::streamsize size = in.tellg();
+    in.seekg(0);
+    bytes.resize((std::size_t)size);
+    in.read((char*)bytes.data(), size);
+    return in.good();
+}
+
+bool write_bytes(const fs::path& p, const std::vector<unsigned char>& bytes) {
+    std::error_code ec;
+    fs::create_directories(p.parent_path(), ec);
+    std::ofstream out(p, std::ios::binary);
+    out.write((const char*)bytes.data(), bytes.size());
+    return out.good();
+}
+
+// Etapa de calculo: decodifica, aplica las operaciones y deja el archivo nuevo en t.bytes
+bool convert(Task& t, const Options& opt) {
+    TGAImage img;
+    if (!img.read_tga_memory(t.bytes.data(), t.bytes.size()))
+        return false;
+    t.pixels = (std::uint64_t)img.get_width() * img.get_height();
+    if (opt.width > 0 && !tga_resample(img, img, opt.width, opt.height, opt.filter))
+        return false;
+    if (opt.flip_h)
+        img.flip_horizontally();
+    if (opt.flip_v)
+        img.flip_vertically();
+    if (opt.format && !img.convert((TGAImage::Format)opt.format))
+        return false;
+    return img.write_tga_memory(t.bytes, opt.rle, 1, opt.origin);
+}
+
+bool parse_origin(const std::string& s, TGAImage::Origin& origin) {
+    if (s == "tl")
+        origin = TGAImage::TOP_LEFT;
+    else if (s == "tr")
+        origin = TGAImage::TOP_RIGHT;
+    else if (s == "bl")
+        origin = TGAImage::BOTTOM_LEFT;
+    else if (s == "br")
+        origin = TGAImage::BOTTOM_RIGHT;
+    else
+        return false;
+    return true;
+}
+
+bool parse_format(const std::string& s, int& format) {
+    if (s == "gray")
+        format = TGAImage::GRAYSCALE;
+    else if (s == "rgb")
+        format = TGAImage::RGB;
+    else if (s == "rgba")
+        format = TGAImage::RGBA;
+    else
+        return false;
+    return true;
+}
+
+bool parse_filter(const std::string& s, TGAFilter& filter) {
+    if (s == "box")
+        filter = TGA_FILTER_BOX;
+    else if (s == "bilinear")
+        filter = TGA_FILTER_BILINEAR;
+    else if (s == "bicubic")
+        filter = TGA_FILTER_BICUBIC;
+    else if (s == "lanczos3")
+        filter = TGA_FILTER_LANCZOS3;
+    else
+        return false;
+    return true;
+}
+
+void usage(const char* argv0) {
+    std::fprintf(stderr,
+                 "usage: %s -o <dir> [options] <file.tga | dir>...\n"
+                 "  -o <dir>              output directory (directory inputs keep their relative paths,\n"
+                 "                        inputs that map to the same output file are rejected)\n"
+                 "  --list <file>         also read input paths from a file, one per line\n"
+                 "  --rle | --raw         output compression (default: --rle)\n"
+                 "  --origin tl|tr|bl|br  origin stored in the output files (default: tl)\n"
+                 "  --flip-h, --flip-v    flip the pixels\n"
+                 "  --resize <w>x<h>      resample to w x h\n"
+                 "  --filter box|bilinear|bicubic|lanczos3  resampling filter (default: bicubic)\n"
+                 "  --format gray|rgb|rgba  convert the pixels (default: keep each file's format)\n"
+                 "  -j <n>                compute threads (default: all cores)\n"
+                 "  --io-threads <n>      reader threads and writer threads (default: 2)\n",
+                 argv0);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options opt;
+    std::vector<std::string> inputs;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "-o" && has_value) {
+            opt.out_dir = argv[++i];
+        } else if (arg == "--list" && has_value) {
+            std::ifstream list(argv[++i]);
+            for (std::string line; std::getline(list, line);)
+                if (!line.empty())
+                    inputs.push_back(line);
+        } else if (arg == "--rle" || arg == "--raw") {
+            opt.rle = arg == "--rle";
+        } else if (arg == "--origin" && has_value) {
+            if (!parse_origin(argv[++i], opt.origin)) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (arg == "--flip-h" || arg == "--flip-v") {
+            (arg == "--flip-h" ? opt.flip_h : opt.flip_v) = true;
+        } else if (arg == "--resize" && has_value) {
+            if (std::sscanf(argv[++i], "%dx%d", &opt.width, &opt.height) != 2 || opt.width <= 0 || opt.height <= 0) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (arg == "--filter" && has_value) {
+            if (!parse_filter(argv[++i], opt.filter)) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (arg == "--format" && has_value) {
+            if (!parse_format(argv[++i], opt.format)) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (arg == "-j" && has_value) {
+            opt.threads = std::atoi(argv[++i]);
+        } else if (arg == "--io-threads" && has_value) {
+            opt.io_threads = std::max(1, std::atoi(argv[++i]));
+        } else if (!arg.empty() && arg[0] == '-') {
+            usage(argv[0]);
+            return 1;
+        } else {
+            inputs.push_back(arg);
+        }
+    }
+    if (opt.out_dir.empty() || inputs.empty()) {
+        usage(argv[0]);
+        return 1;
+    }
+    tga_set_log_level(TGA_LOG_NONE); // Los errores se informan aqui, con el nombre del archivo
+
+    std::vector<Task> tasks;
+    for (const std::string& in : inputs)
+        collect(in, opt.out_dir, tasks);
+    if (!check_outputs(tasks))
+        return 1;
+    for (std::size_t i = 0; i < tasks.size(); i++)
+        tasks[i].id = i;
+
+    int nthreads = tga_resolve_threads(opt.threads);
+    std::size_t capacity = 4 * (std::size_t)nthreads; // Archivos en memoria esperando en cada etapa
+    StealingPool pool(nthreads, capacity);
+    BoundedQueue done(capacity);
+    std::atomic<std::size_t> next_read(0);
+    std::atomic<std::size_t> failed(0);
+    std::atomic<std::uint64_t> bytes_in(0);
+    std::atomic<std::uint64_t> bytes_out(0);
+    std::atomic<std::uint64_t> pixels(0);
+    std::mutex report_mutex;
+    auto fail = [&](const Task& t, const char* what) {
+        std::lock_guard<std::mutex> lock(report_mutex);
+        std::fprintf(stderr, "%s: %s\n", t.input.string().c_str(), what);
+        failed++;
+    };
+
+    auto t0 = std::chrono::steady_clock::now();
+
+    // Etapa 1: lectura
+    std::vector<std::thread> readers;
+    std::atomic<int> readers_left(opt.io_threads);
+    for (int r = 0; r < opt.io_threads; r++) {
+        readers.emplace_back([&]() {
+            for (std::size_t i = next_read++; i < tasks.size(); i = next_read++) {
+                Task t = std::move(tasks[i]);
+                if (!read_bytes(t.input, t.bytes)) {
+                    fail(t, "can't read file");
+                    continue;
+                }
+                bytes_in += t.bytes.size();
+                pool.push(std::move(t));
+            }
+            if (--readers_left == 0)
+                pool.close();
+        });
+    }
+
+    // Etapa 2: calculo
+    std::vector<std::thread> workers;
+    std::atomic<int> workers_left(nthreads);
+    for (int w = 0; w < nthreads; w++) {
+        workers.emplace_back([&, w]() {
+            Task t;
+            while (pool.pop(w, t)) {
+                if (!convert(t, opt)) {
+                    fail(t, "can't convert file");
+                    continue;
+                }
+                pixels += t.pixels;
+                done.push(std::move(t));
+            }
+            if (--workers_left == 0)
+                done.close();
+        });
+    }
+
+    // Etapa 3: escritura
+    std::vector<std::thread> writers;
+    for (int r = 0; r < opt.io_threads; r++) {
+        writers.emplace_back([&]() {
+            Task t;
+            while (done.pop(t)) {
+                if (!write_bytes(t.output, t.bytes)) {
+                    fail(t, "can't write file");
+                    continue;
+                }
+                bytes_out += t.bytes.size();
+            }
+        });
+    }
+
+    for (std::thread& th : readers)
+        th.join();
+    for (std::thread& th : workers)
+        th.join();
+    for (std::thread& th : writers)
+        th.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    std::size_t ok = tasks.size() - failed;
+    std::printf("files: %zu converted, %zu failed\n", ok, (std::size_t)failed);
+    std::printf("time: %.3f s, %.1f files/s\n", seconds, ok / seconds);
+    std::printf("input: %.1f MB (%.1f MB/s), output: %.1f MB (%.1f MB/s)\n", bytes_in / 1e6, bytes_in / 1e6 / seconds,
+                bytes_out / 1e6, bytes_out / 1e6 / seconds);
+    std::printf("pixels: %.1f Mpixels/s\n", pixels / 1e6 / seconds);
+    return failed ? 1 : 0;
+}
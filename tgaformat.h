@@ -0,0 +1,64 @@
+#ifndef __TGAFORMAT_H__
+#define __TGAFORMAT_H__
+
+// Partes fijas del formato .tga compartidas por los archivos .cpp de la libreria (no es parte de la API)
+
+#include <cstring>
+#include "tgaimage.h"
+
+// Bytes entre el inicio del archivo y el primer pixel: el header, el campo de identificacion y el colormap
+inline std::size_t tga_data_offset(const TGA_Header& header) {
+	std::size_t offset = sizeof(header) + (std::uint8_t)header.idlength;
+	if (header.colormaptype)
+		offset += (std::size_t)(unsigned short)header.colormaplength * (((std::uint8_t)header.colormapdepth + 7) / 8);
+	return offset;
+}
+
+// Archivos cuyos pixeles se expanden al leerlos en vez de copiarse tal cual: color-mapped (tipos 1 y 9, con
+// indices de 8 o 16 bits) y true-color de 15 o 16 bits (tipos 2 y 10)
+inline bool tga_is_expanded(const TGA_Header& header) {
+	int code = header.datatypecode;
+	int bits = (std::uint8_t)header.bitsperpixel;
+	return code == 1 || code == 9 || ((code == 2 || code == 10) && (bits == 15 || bits == 16));
+}
+
+// Revisar el manual de Truevsion
+// Variables para el footer
+/*
+	Bytes 0-3: The Extension Area Offset
+	Bytes 4-7: The Developer Directory Offset
+	Bytes 8-23: The Signature
+	Byte 24: ASCII Character “.”
+	Byte 25: Binary zero string terminator (0x00)
+*/
+const unsigned char developer_area_ref[4] = { 0, 0, 0, 0 };
+const unsigned char extension_area_ref[4] = { 0, 0, 0, 0 };
+const unsigned char footer[18] = { 'T', 'R', 'U', 'E', 'V', 'I', 'S', 'I', 'O',
+                                   'N', '-', 'X', 'F', 'I', 'L', 'E', '.', '\0' }; // byte 8 al 25
+
+inline TGA_Header tga_make_header(int width, int height, int bytespp, bool rle, int origin) {
+	TGA_Header header;
+	std::memset((void*)&header, 0, sizeof(header)); // Reemplaza con 0x00 cada byte de header (que pesa 18 bytes)
+
+	// Se copian los valores trascendentes de la imagen al header creado
+	header.bitsperpixel = bytespp * 8; // bytespp << 3;
+	header.width = width;
+	header.height = height;
+	/*
+			0 no image data is present
+			1 uncompressed color-mapped image
+			2 uncompressed true-color image                         (***)
+			3 uncompressed black-and-white (grayscale) image        (***)
+			9 run-length encoded color-mapped image
+			10 run-length encoded true-color image                  (***)
+			11 run-length encoded black-and-white (grayscale) image (***)
+	*/
+	header.datatypecode = (bytespp == TGAImage::GRAYSCALE ? (rle ? 11 : 3) : (rle ? 10 : 2));
+
+	// Por defecto el origen es la esquina superior inzquierda (top-left origin 0b0010'0000); con otro origen
+	// las filas se reordenan mientras se escriben, los pixeles de la imagen no se voltean
+	header.imagedescriptor = origin;
+	return header;
+}
+
+#endif //__TGAFORMAT_H__
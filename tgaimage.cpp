@@ -1,55 +1,353 @@
 #include "tgaimage.h"
+#include "tgaformat.h"
+#include "tgakernels.h"
+#include "tgarle.h"
+#include "tgastats.h"
+#include "tgathreads.h"
+#include <algorithm>
+#include <atomic>
 #include <cmath>
+#include <cstdint>
 #include <cstring>
 #include <ctime>
+#include <filesystem> // std::filesystem::last_write_time()
 #include <fstream>  // Para usar std::ifstream y std::ofstream
-#include <iostream> // std::cout
+#include <vector>
+
+#if defined(_WIN32)
+#define TGA_HAVE_WRITEV 0
+#else
+#define TGA_HAVE_WRITEV 1
+#include <cerrno>    // errno, EINTR
+#include <sys/uio.h> // writev()
+#endif
+
+#if defined(_WIN32)
+#define TGA_HAVE_MMAP 0
+#else
+#define TGA_HAVE_MMAP 1
+#include <fcntl.h>    // open()
+#include <sys/mman.h> // mmap(), munmap()
+#include <sys/stat.h> // fstat()
+#include <unistd.h>   // ::close()
+#endif
+
+namespace {
+
+// Verifica que el header sea de un .tga con RLE que se pueda decodificar
+bool tga_valid_rle_header(const TGA_Header& header) {
+    int bytespp = header.bitsperpixel / 8;
+    if (header.width <= 0 || header.height <= 0 ||
+        (bytespp != TGAImage::GRAYSCALE && bytespp != TGAImage::RGB && bytespp != TGAImage::RGBA)) {
+        tga_log() << "bad bpp (or width/height) value\n";
+        return false;
+    }
+    if (header.datatypecode != 10 && header.datatypecode != 11) {
+        tga_log() << "unknown file format " << (int)header.datatypecode << "\n";
+        return false;
+    }
+    return true;
+}
 
-TGAImage::TGAImage() : m_data(nullptr), m_width(0), m_height(0), m_bytespp(0) {}
+// Fila fr en el orden del archivo segun origin (bits del imagedescriptor). Si las filas van de abajo hacia
+// arriba se toma la fila de la imagen desde el final; si los pixeles van de derecha a izquierda la fila se
+// copia invertida en scratch. Con copy = true la fila siempre se deja en scratch
+const unsigned char* tga_file_row(const unsigned char* data, int width, int height, int bytespp, int origin, int fr,
+                                  unsigned char* scratch, bool copy = false) {
+    std::size_t row_bytes = (std::size_t)width * bytespp;
+    const unsigned char* row = data + (origin & 0x20 ? fr : height - 1 - fr) * row_bytes;
+    if (origin & 0x10) {
+        tga_reverse_copy(scratch, row, width, bytespp);
+        return scratch;
+    }
+    if (copy) {
+        std::memcpy(scratch, row, row_bytes);
+        return scratch;
+    }
+    return row;
+}
 
-TGAImage::TGAImage(int w, int h, int bpp) : m_data(nullptr), m_width(w), m_height(h), m_bytespp(bpp) {
-    unsigned long nbytes = m_width * m_height * m_bytespp; // nbytes representa la cantidad de bytes que necesita m_data
-    m_data = new unsigned char[nbytes];                    // Cada pixel requiere m_bytespp por pixel
-    std::memset(m_data, 0, nbytes);                        // Se le asigna 0 a todos los bytes de data
+// Decodifica nrows filas seguidas del archivo y deja cada una directamente en dst_row(i), i = 0 .. nrows - 1.
+// Asi la orientacion del archivo se corrige mientras se decodifica, sin otra pasada por toda la imagen.
+// Retorna en *skip lo que queda del ultimo paquete (0 si termino justo al final de la ultima fila)
+template <class Reader, class RowFn>
+bool decode_rle_rows(Reader& src, int bytespp, int width, int nrows, unsigned long* skip, bool right_to_left,
+                     RowFn dst_row) {
+    for (int i = 0; i < nrows; i++) {
+        unsigned char* dst = dst_row(i);
+        if (!decode_rle(bytespp, src, dst, width, *skip, true, skip))
+            return false;
+        if (right_to_left)
+            tga_reverse_pixels(dst, width, bytespp);
+    }
+    return true;
 }
 
-TGAImage::TGAImage(const TGAImage& img) {
-    m_width = img.m_width;
-    m_height = img.m_height;
-    m_bytespp = img.m_bytespp;
-    unsigned long nbytes = m_width * m_height * m_bytespp;
-    m_data = new unsigned char[nbytes];
-    std::memcpy(m_data, img.m_data, nbytes); // std::mempcpy copia los bytes de img.m_data a m_data
+// Lee n bytes de src en dst, en partes que entren en el bloque de RLEBlockReader
+template <class Reader> bool read_bytes(Reader& src, unsigned char* dst, std::size_t n) {
+    while (n > 0) {
+        std::size_t part = std::min<std::size_t>(n, 4096);
+        if (!src.require(part))
+            return false;
+        std::memcpy(dst, src.data(), part);
+        src.advance(part);
+        dst += part;
+        n -= part;
+    }
+    return true;
 }
 
-TGAImage::~TGAImage() {
-    if (m_data)          // Verifica que m_data no sea un puntero nulo
-        delete[] m_data; // Libera la memoria assignada y el SO vuelve a tener esa memoria a su disposicion
+// Decodifica un archivo color-mapped o de 15/16 bits (ver tga_is_expanded()) en img. src entrega el archivo desde
+// el byte siguiente al header. Cada fila se decodifica (o se lee) con los indices o pixeles de 16 bits tal cual
+// estan en el archivo y se expande a RGB o RGBA directamente en su lugar segun el origen.
+// Los pixeles de 16 bits (y las entradas de 16 bits del colormap) tienen alpha solo si el header indica bits de
+// atributo (imagedescriptor & 0x0F); las entradas de 32 bits siempre lo tienen
+template <class Reader>
+bool decode_expanded(Reader& src, const TGA_Header& header, TGAAllocator* allocator, TGAImage& img) {
+    int width = header.width;
+    int height = header.height;
+    bool mapped = header.datatypecode == 1 || header.datatypecode == 9;
+    bool rle = header.datatypecode == 9 || header.datatypecode == 10;
+    int src_bytes = ((std::uint8_t)header.bitsperpixel + 7) / 8; // Indice o pixel de 16 bits
+    bool alpha16 = (header.imagedescriptor & 0x0F) != 0;
+    int map_origin = (unsigned short)header.colormaporigin;
+    int map_length = (unsigned short)header.colormaplength;
+    int map_bits = (std::uint8_t)header.colormapdepth;
+    int map_bytes = (map_bits + 7) / 8;
+    if (width <= 0 || height <= 0 || src_bytes < 1 || src_bytes > 2 ||
+        (mapped && (!header.colormaptype || map_length <= 0 || (map_bytes != 2 && map_bytes != 3 && map_bytes != 4) ||
+                    map_origin + map_length > (1 << (8 * src_bytes))))) {
+        tga_log() << "bad bpp (or width/height) value\n";
+        return false;
+    }
+    int bytespp = mapped ? (map_bytes == 4 || (map_bytes == 2 && alpha16) ? TGAImage::RGBA : TGAImage::RGB)
+                         : (alpha16 ? TGAImage::RGBA : TGAImage::RGB);
+
+    // Campo de identificacion y colormap. Los colores del colormap se pasan a BGRA en una tabla con una entrada
+    // por cada indice posible, asi expandir un indice es una sola lectura sin verificar limites
+    std::vector<unsigned char> skipped((std::uint8_t)header.idlength + (std::size_t)map_length * map_bytes *
+                                       (header.colormaptype ? 1 : 0));
+    if (!read_bytes(src, skipped.data(), skipped.size())) {
+        tga_log() << "an error occured while reading the colormap\n";
+        return false;
+    }
+    std::vector<std::uint32_t> lut;
+    if (mapped) {
+        lut.assign((std::size_t)1 << (8 * src_bytes), 0);
+        const unsigned char* map = skipped.data() + (std::uint8_t)header.idlength;
+        std::uint32_t* entries = lut.data() + map_origin;
+        if (map_bytes == 2) {
+            tga_unpack_pixels16((unsigned char*)entries, 4, map, map_length, alpha16);
+        } else {
+            for (int i = 0; i < map_length; i++) {
+                unsigned char c[4] = { 0, 0, 0, 255 };
+                std::memcpy(c, map + i * map_bytes, map_bytes);
+                std::memcpy(&entries[i], c, 4);
+            }
+        }
+    }
+
+    TGAImage decoded(width, height, bytespp, allocator, false);
+    bool bottom_up = !(header.imagedescriptor & 0x20);
+    bool right_to_left = header.imagedescriptor & 0x10;
+    std::size_t row_bytes = (std::size_t)width * bytespp;
+    std::vector<unsigned char> row((std::size_t)width * src_bytes);
+    unsigned long skip = 0;
+    for (int fr = 0; fr < height; fr++) {
+        bool ok = rle ? decode_rle(src_bytes, src, row.data(), width, skip, true, &skip)
+                      : read_bytes(src, row.data(), row.size());
+        if (!ok) {
+            tga_log() << "an error occured while reading the data\n";
+            return false;
+        }
+        unsigned char* dst = decoded.buffer() + (bottom_up ? height - 1 - fr : fr) * row_bytes;
+        if (mapped)
+            tga_lookup_pixels(dst, bytespp, row.data(), src_bytes, lut.data(), width);
+        else
+            tga_unpack_pixels16(dst, bytespp, row.data(), width, alpha16);
+        if (right_to_left)
+            tga_reverse_pixels(dst, width, bytespp);
+    }
+    if (skip) {
+        tga_log() << "Too many pixels read\n";
+        return false;
+    }
+    img = std::move(decoded);
+    return true;
+}
+
+} // namespace
+
+unsigned char* TGAAlignedAllocator::allocate(std::size_t nbytes) {
+    return (unsigned char*)::operator new(nbytes, std::align_val_t(m_alignment));
+}
+
+void TGAAlignedAllocator::deallocate(unsigned char* p, std::size_t) {
+    ::operator delete((void*)p, std::align_val_t(m_alignment));
+}
+
+TGAAllocator* tga_default_allocator() {
+    static TGAAlignedAllocator allocator;
+    return &allocator;
+}
+
+TGAFramePool::TGAFramePool(std::size_t max_free, std::size_t alignment)
+    : m_base(alignment), m_max_free(max_free), m_heap_allocs(0) {}
+
+TGAFramePool::~TGAFramePool() { trim(); }
+
+unsigned char* TGAFramePool::allocate(std::size_t nbytes) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (std::size_t i = 0; i < m_free.size(); i++) {
+            if (m_free[i].nbytes == nbytes) { // Se reutiliza un buffer del mismo tamanio
+                unsigned char* p = m_free[i].data;
+                m_free[i] = m_free.back();
+                m_free.pop_back();
+                return p;
+            }
+        }
+        m_heap_allocs++;
+    }
+    return m_base.allocate(nbytes);
+}
+
+void TGAFramePool::deallocate(unsigned char* p, std::size_t nbytes) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_free.size() < m_max_free) {
+            m_free.push_back({ p, nbytes });
+            return;
+        }
+    }
+    m_base.deallocate(p, nbytes);
+}
+
+void TGAFramePool::trim() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (const Block& b : m_free)
+        m_base.deallocate(b.data, b.nbytes);
+    m_free.clear();
+}
+
+std::size_t TGAFramePool::heap_allocations() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_heap_allocs;
+}
+
+// Paquetes RLE de cada fila de la imagen, indexados por fila de la imagen (no del archivo): el orden vertical del
+// origen se resuelve al armar el archivo, asi solo hay que codificar todo de nuevo si cambia el sentido horizontal
+struct TGARowCache {
+    std::vector<std::vector<unsigned char>> rows;
+    std::vector<unsigned char> dirty; // 1 si la fila cambio desde que se codifico
+    int width = 0;
+    int bytespp = 0;
+    bool reversed = false; // Las filas se codificaron invertidas (origen a la derecha)
+
+    void mark(int y0, int y1) {
+        y0 = std::max(y0, 0);
+        y1 = std::min(y1, (int)dirty.size());
+        if (y0 < y1)
+            std::memset(dirty.data() + y0, 1, y1 - y0);
+    }
+};
+
+TGAImage::TGAImage() : m_data(nullptr), m_width(0), m_height(0), m_bytespp(0), m_allocator(tga_default_allocator()) {}
+
+TGAImage::TGAImage(int w, int h, int bpp, TGAAllocator* allocator, bool zeroed)
+    : m_data(nullptr), m_width(0), m_height(0), m_bytespp(0),
+      m_allocator(allocator ? allocator : tga_default_allocator()) {
+    allocate(w, h, bpp, zeroed); // Cada pixel requiere m_bytespp por pixel
+}
+
+TGAImage::TGAImage(const TGAImage& img)
+    : m_data(nullptr), m_width(0), m_height(0), m_bytespp(0), m_allocator(img.m_allocator) {
+    allocate(img.m_width, img.m_height, img.m_bytespp);
+    if (m_data) // std::mempcpy copia los bytes de img.m_data a m_data
+        std::memcpy(m_data, img.m_data, (std::size_t)m_width * m_height * m_bytespp);
+}
+
+TGAImage::TGAImage(TGAImage&& img) noexcept
+    : m_data(img.m_data), m_width(img.m_width), m_height(img.m_height), m_bytespp(img.m_bytespp),
+      m_allocator(img.m_allocator) {
+    img.m_data = nullptr; // img queda como una imagen vacia
+    img.m_width = img.m_height = img.m_bytespp = 0;
+}
+
+TGAImage::~TGAImage() { release(); }
+
+void TGAImage::track_changes(bool enable) {
+    if (!enable)
+        m_row_cache.reset();
+    else if (!m_row_cache)
+        m_row_cache.reset(new TGARowCache()); // Sin filas guardadas: la primera escritura codifica todo
+}
+
+void TGAImage::mark_dirty(int y0, int y1) {
+    if (m_row_cache)
+        m_row_cache->mark(y0, y1);
 }
 
 TGAImage& TGAImage::operator=(const TGAImage& img) {
     if (this != &img) { // Verifica: Direccion de memoria de img sea diferente que this(ptr al objeto siendo asignado)
-        if (m_data)     // Verifica: m_data no sea  un puntero nulo
-            delete[] m_data; // Se libera la memoria de m_data para luego copiarle la de img.m_data
+        // Si las dos imagenes tienen el mismo tamanio allocate() reutiliza m_data
+        allocate(img.m_width, img.m_height, img.m_bytespp);
+        if (m_data)
+            std::memcpy(m_data, img.m_data, (std::size_t)m_width * m_height * m_bytespp);
+    }
+    return *this;
+}
+
+TGAImage& TGAImage::operator=(TGAImage&& img) noexcept {
+    if (this != &img) {
+        release();
+        m_data = img.m_data;
         m_width = img.m_width;
         m_height = img.m_height;
         m_bytespp = img.m_bytespp;
-        unsigned long nbytes = m_width * m_height * m_bytespp;
-        m_data = new unsigned char[nbytes];
-        std::memcpy(m_data, img.m_data, nbytes);
+        m_allocator = img.m_allocator; // El buffer se tiene que liberar con el allocator que lo reservo
+        img.m_data = nullptr;
+        img.m_width = img.m_height = img.m_bytespp = 0;
+        mark_dirty(); // El seguimiento de cambios sigue siendo de *this
     }
     return *this;
 }
 
+void TGAImage::allocate(int w, int h, int bpp, bool zeroed) {
+    std::size_t nbytes = (std::size_t)w * h * bpp; // nbytes representa la cantidad de bytes que necesita m_data
+    if (!m_data || nbytes != (std::size_t)m_width * m_height * m_bytespp) {
+        release();
+        m_data = nbytes ? m_allocator->allocate(nbytes) : nullptr;
+        if (nbytes) {
+            tga_stats_add(TGA_STAT_ALLOCATIONS, 1);
+            tga_stats_add(TGA_STAT_ALLOCATED_BYTES, nbytes);
+        }
+    }
+    m_width = w;
+    m_height = h;
+    m_bytespp = bpp;
+    if (zeroed && m_data)
+        std::memset(m_data, 0, nbytes); // Se le asigna 0 a todos los bytes de data
+    mark_dirty(); // Pixeles nuevos (o que se van a sobreescribir, como al leer un archivo)
+}
+
+void TGAImage::release() {
+    if (m_data) // Libera la memoria assignada y el SO (o el pool) vuelve a tener esa memoria a su disposicion
+        m_allocator->deallocate(m_data, (std::size_t)m_width * m_height * m_bytespp);
+    m_data = nullptr;
+}
+
+bool TGAImage::read_tga_file(const char* filename, Format format) {
+    return read_tga_file(filename) && convert(format);
+}
+
 bool TGAImage::read_tga_file(const char* filename) {
     // Como leer un .tga no necesriamente coincidira *this, entonces es como crear un nuevo objeto
-    if (m_data)          // Verifica: m_data no sea un puntero nulo
-        delete[] m_data; // Libera la memoria de m_data
-    m_data = nullptr;
+    release(); // Libera la memoria de m_data
     std::ifstream in;                    // Objeto de tipo std::ifstream
     in.open(filename, std::ios::binary); // Abre el archivo en modo binario, no vamos a interpretar texto con formato
     if (!in.is_open()) {                 // Verifica que in este asociado a un archivo de verdad :v
-        std::cerr << "can't open file " << filename << "\n";
+        tga_log() << "can't open file " << filename << "\n";
         in.close();
         return false;
     }
@@ -60,9 +358,21 @@ bool TGAImage::read_tga_file(const char* filename) {
 
     if (!in.good()) { // Retorna true si ninguna de las banderas de error han cambiado, badbit, failbit, eofbit
         in.close();
-        std::cerr << "an error occured while reading the header\n";
+        tga_log() << "an error occured while reading the header\n";
         return false;
     }
+    if (tga_is_expanded(header)) { // Color-mapped o de 15/16 bits: los pixeles se expanden a RGB o RGBA
+        TGAStatTimer timer(TGA_STAT_DECODES, TGA_STAT_DECODE_NS);
+        RLEBlockReader src(in);
+        bool ok = decode_expanded(src, header, m_allocator, *this);
+        tga_stats_add(TGA_STAT_BYTES_READ, sizeof(header) + src.position());
+        if (!ok)
+            return false;
+        tga_stats_add(TGA_STAT_FILES_READ, 1);
+        tga_log(TGA_LOG_INFO) << m_width << "x" << m_height << "/" << (int)header.bitsperpixel
+                              << " bits per pixel (expanded to " << m_bytespp * 8 << ")\n";
+        return true;
+    }
     m_width = header.width; // Copia los valores del header a los valores del TGAImage
     m_height = header.height;
     m_bytespp = header.bitsperpixel / 8; // Un bytes son 8 bits
@@ -70,13 +380,16 @@ bool TGAImage::read_tga_file(const char* filename) {
     // Condicional que verifica que la altura, el ancho y los valores de m_bytespp sean aceptables
     if (m_width <= 0 || m_height <= 0 || (m_bytespp != GRAYSCALE && m_bytespp != RGB && m_bytespp != RGBA)) {
         in.close();
-        std::cerr << "bad bpp (or width/height) value\n";
+        tga_log() << "bad bpp (or width/height) value\n";
         return false;
     }
 
+    // Se saltan el campo de identificacion y el colormap (si hay) para llegar a los pixeles
+    in.ignore(tga_data_offset(header) - sizeof(header));
+
     // Se asinga a m_data la cnatidad de bytes necesarios basandose en los datos de header
-    unsigned long nbytes = m_bytespp * m_width * m_height;
-    m_data = new unsigned char[nbytes];
+    unsigned long nbytes = (unsigned long)m_bytespp * m_width * m_height;
+    allocate(m_width, m_height, m_bytespp);
 
     /*
         0 no image data is present
@@ -88,332 +401,1265 @@ bool TGAImage::read_tga_file(const char* filename) {
         11 run-length encoded black-and-white (grayscale) image (***)
     */
 
+    /*
+        Bit 4 of the image descriptor byte indicates right-to-left pixel ordering if set.
+        Bit 5 indicates an ordering of top-to-bottom. Otherwise, pixels are stored in bottom-to-top, left-to-right
+       order.
+
+        Los bits de los .tga se cuentan asi (Se cuentan asi debido al manual que dio
+        Trueision Inc) 7 | 6 | 5 | 4 | 3 | 2 | 1 | 0
+        - - - - - - - - - - - - - - -
+        0 | 0 | x | x | 0 | 0 | 0 | 0 // Son los bits que determinan el Origen de la imagen
+
+        En vez de voltear la imagen despues de leerla, cada fila se guarda directamente en su lugar:
+        si el bit 5 NO esta seteado la primera fila del archivo es la ultima de la imagen, y si el bit 4
+        esta seteado cada fila se invierte apenas se lee (mientras todavia esta en cache)
+    */
+    bool bottom_up = !(header.imagedescriptor & 0x20); // 0x20 == 0b0010'0000
+    bool right_to_left = header.imagedescriptor & 0x10; // 0x10 == 0b0001'0000
+
+    bool rle = header.datatypecode == 10 || header.datatypecode == 11;
     if (header.datatypecode == 3 || header.datatypecode == 2) { // True si no es rle
-        in.read((char*)m_data, nbytes);                         // Copia los bytes del archivo asociado en m_data
+        if (!bottom_up && !right_to_left) {
+            in.read((char*)m_data, nbytes); // Copia los bytes del archivo asociado en m_data
+        } else {
+            std::size_t row_bytes = (std::size_t)m_width * m_bytespp;
+            for (int fr = 0; fr < m_height && in.good(); fr++) {
+                unsigned char* row = m_data + (bottom_up ? m_height - 1 - fr : fr) * row_bytes;
+                in.read((char*)row, row_bytes);
+                if (right_to_left)
+                    tga_reverse_pixels(row, m_width, m_bytespp);
+            }
+        }
         if (!in.good()) {
             in.close();
-            std::cerr << "an error occured while reading the data\n";
+            tga_log() << "an error occured while reading the data\n";
             return false;
         }
-    } else if (header.datatypecode == 10 || header.datatypecode == 11) {
+    } else if (rle) {
         // Como esta comprimido no se lee byte por byte, se llama a load_rle_data(), retorna falso si se encuentra un
         // error
-        if (!load_rle_data(in)) {
+        if (!load_rle_data(in, header.imagedescriptor)) {
             in.close();
-            std::cerr << "an error occured while reading the data\n";
+            tga_log() << "an error occured while reading the data\n";
             return false;
         }
     } else { // Si es que no encuentra el formato que se esta trabajando entonces retorna false
         in.close();
-        std::cerr << "unknown file format " << (int)header.datatypecode << "\n";
+        tga_log() << "unknown file format " << (int)header.datatypecode << "\n";
         return false;
     }
 
-    /*
-        Bit 4 of the image descriptor byte indicates right-to-left pixel ordering if set.
-        Bit 5 indicates an ordering of top-to-bottom. Otherwise, pixels are stored in bottom-to-top, left-to-right
-       order.
+    tga_stats_add(TGA_STAT_FILES_READ, 1);
+    tga_stats_add(TGA_STAT_BYTES_READ, tga_data_offset(header) + (rle ? 0 : nbytes)); // load_rle_data() suma el resto
+    // Solo se escribe con el nivel TGA_LOG_INFO (el nivel por defecto), ver tga_set_log_level()
+    tga_log(TGA_LOG_INFO) << m_width << "x" << m_height << "/" << m_bytespp * 8 << " bits per pixel\n";
+    in.close();
+    return true;
+}
 
-        Los bits de los .tga se cuentan asi (Se cuentan asi debido al manual que dio
-        Trueision Inc) 7 | 6 | 5 | 4 | 3 | 2 | 1 | 0
-        - - - - - - - - - - - - - - -
-        0 | 0 | x | x | 0 | 0 | 0 | 0 // Son los bits que determinan el Origen de la imagen
+bool TGAImage::load_rle_data(std::ifstream& in, int imagedescriptor) {
+    /*
+        En RLE (Run-Length-Encoded) en los .tga, hay paquetes que se conforman de 2 partes:
+        El primer byte representa la cantidad de veces que se repite un pixel, y los siguientes
+        la informacion del pixel (color), la cantidad de bytes de esa parte depende de bitsPerPixel.
+        Si el primer byte tiene el primer bit seteado (0b1000'0000), se llama Run-length packet y
+        los demás bits conforman la cantidad de pixeles a repetirse sumados con 1. Ver el manual de
+        Truevision. Por lo tanto 0b1111'1111(0xFF) represeta que el pixel se
+        repite 128 veces, y 0b1000'0011(0x83) que se repite 4 veces por ejemplo.
+        Se le resto 0b1000'0000(0x80) + 0x01 para determinar la cantidad de veces que se repite un pixel
+        Si el primer bit por el contrario es 0, se llama Raw packet(No RLE), los demas
+        bits representan la cantidad de pixeles que hay de ahi en adelante.
+
+        Los paquetes se decodifican con decode_rle<BPP>(), especializado para cada valor de m_bytespp, y
+        cada fila queda directamente en su lugar segun el origen indicado en imagedescriptor.
     */
+    TGAStatTimer timer(TGA_STAT_DECODES, TGA_STAT_DECODE_NS);
+    bool bottom_up = !(imagedescriptor & 0x20);
+    std::size_t row_bytes = (std::size_t)m_width * m_bytespp;
+    unsigned long skip = 0;
+    RLEBlockReader src(in);
+    bool ok = decode_rle_rows(src, m_bytespp, m_width, m_height, &skip, imagedescriptor & 0x10,
+                              [&](int fr) { return m_data + (bottom_up ? m_height - 1 - fr : fr) * row_bytes; });
+    tga_stats_add(TGA_STAT_BYTES_READ, src.position());
+    if (!ok)
+        return false;
+    if (skip) { // El ultimo paquete se pasa del final de la imagen
+        tga_log() << "Too many pixels read\n";
+        return false;
+    }
+    return true;
+}
+
+namespace {
 
-    // Si el header.imagedescriptor tiene el bit 5 NO seteado entonces se hace un flip verticalmente
-    if (!(header.imagedescriptor & 0x20)) { // 0x20 == 0b0010'0000
-        flip_vertically();
+// Fecha de modificacion de un archivo, sirve para saber si un indice guardado sigue correspondiendo al archivo
+std::int64_t tga_file_time(const char* filename) {
+    std::error_code ec;
+    auto t = std::filesystem::last_write_time(filename, ec);
+    return ec ? 0 : (std::int64_t)t.time_since_epoch().count();
+}
+
+// Archivo completo de solo lectura. Se mapea con mmap, asi no se copia y cada hilo carga solo las paginas que
+// toca; donde no hay mmap se lee entero en un vector
+class TGAFileBytes {
+    const unsigned char* m_data;
+    std::size_t m_size;
+    bool m_mapped;
+    std::vector<unsigned char> m_bytes;
+
+public:
+    TGAFileBytes() : m_data(nullptr), m_size(0), m_mapped(false) {}
+    ~TGAFileBytes() {
+#if TGA_HAVE_MMAP
+        if (m_mapped)
+            munmap((void*)m_data, m_size);
+#endif
     }
+    TGAFileBytes(const TGAFileBytes&) = delete;
+    TGAFileBytes& operator=(const TGAFileBytes&) = delete;
 
-    // Si el header.imagedescriptor tiene el bit 4 seteado entonces se hace un flip hirizontalmente
-    if (header.imagedescriptor & 0x10) { // 0x10 == 0b0001'0000
-        flip_horizontally();
+    bool open(const char* filename) {
+#if TGA_HAVE_MMAP
+        int fd = ::open(filename, O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            ::close(fd);
+            return false;
+        }
+        m_size = (std::size_t)st.st_size;
+        if (m_size > 0) { // mmap no acepta un largo de 0 bytes
+            void* map = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (map != MAP_FAILED) {
+                m_data = (const unsigned char*)map;
+                m_mapped = true;
+            }
+        }
+        ::close(fd); // El mapeo sigue siendo valido despues de cerrar el descriptor
+        if (m_mapped || m_size == 0)
+            return true;
+#endif
+        std::ifstream in(filename, std::ios::binary | std::ios::ate); // Se abre al final para conocer el tamanio
+        if (!in.is_open())
+            return false;
+        std::streamsize size = in.tellg();
+        in.seekg(0);
+        m_bytes.resize((std::size_t)size);
+        in.read((char*)m_bytes.data(), size);
+        m_data = m_bytes.data();
+        m_size = m_bytes.size();
+        return in.good();
     }
 
-    // std::cerr funciona como std::cout, pero no hace uso de un buffer
-    std::cerr << m_width << "x" << m_height << "/" << m_bytespp * 8 << " bits per pixel\n";
-    in.close();
+    const unsigned char* data() const { return m_data; }
+    std::size_t size() const { return m_size; }
+};
+
+// Recorre solo los headers de los paquetes (los pixeles se saltan) y anota donde empieza cada banda de step
+// filas. base es la posicion en el archivo del primer byte que entrega src
+template <class Reader>
+bool scan_rle(Reader& src, std::uint64_t base, int bytespp, int width, int height, int step,
+              std::vector<TGARLEIndex::Entry>& entries) {
+    unsigned long pixelcount = (unsigned long)width * height;
+    unsigned long band_pixels = (unsigned long)width * step;
+    unsigned long next_mark = 0; // Primer pixel de la siguiente banda
+    unsigned long currentpixel = 0;
+    entries.clear();
+    while (currentpixel < pixelcount) {
+        if (!src.require(1)) {
+            tga_log() << "an error occured while reading the data\n";
+            return false;
+        }
+        std::uint64_t offset = base + src.position();
+        unsigned char chunkheader = src.data()[0];
+        unsigned long count = (chunkheader & 0x7F) + 1;
+        if (currentpixel + count > pixelcount) {
+            tga_log() << "Too many pixels read\n";
+            return false;
+        }
+        for (; next_mark < currentpixel + count; next_mark += band_pixels)
+            entries.push_back({ offset, (std::uint32_t)(next_mark - currentpixel) });
+        std::size_t packet_bytes = 1 + (chunkheader < 128 ? count * bytespp : bytespp);
+        if (!src.require(packet_bytes)) {
+            tga_log() << "an error occured while reading the data\n";
+            return false;
+        }
+        src.advance(packet_bytes);
+        currentpixel += count;
+    }
+    return true;
+}
+
+const char tga_index_magic[8] = { 'T', 'G', 'A', 'I', 'D', 'X', '1', '\0' };
+
+} // namespace
+
+TGARLEIndex::TGARLEIndex()
+    : m_width(0), m_height(0), m_bytespp(0), m_step(0), m_descriptor(0), m_file_size(0), m_file_time(0) {}
+
+bool TGARLEIndex::build(const char* filename, int step) {
+    m_entries.clear();
+    if (step <= 0)
+        return false;
+    std::ifstream in;
+    in.open(filename, std::ios::binary);
+    if (!in.is_open()) {
+        tga_log() << "can't open file " << filename << "\n";
+        return false;
+    }
+    TGA_Header header;
+    in.read((char*)&header, sizeof(header));
+    if (!in.good()) {
+        tga_log() << "an error occured while reading the header\n";
+        return false;
+    }
+    if (!tga_valid_rle_header(header))
+        return false;
+    std::size_t offset = tga_data_offset(header);
+    in.seekg(offset);
+    RLEBlockReader src(in);
+    if (!scan_rle(src, offset, header.bitsperpixel / 8, header.width, header.height, step, m_entries)) {
+        m_entries.clear();
+        return false;
+    }
+    m_width = header.width;
+    m_height = header.height;
+    m_bytespp = header.bitsperpixel / 8;
+    m_step = step;
+    m_descriptor = (std::uint8_t)header.imagedescriptor;
+    std::error_code ec;
+    m_file_size = std::filesystem::file_size(filename, ec);
+    m_file_time = tga_file_time(filename);
+    return true;
+}
+
+// Formato del sidecar (en el orden de bytes de la maquina): la firma, los campos de la clase y las entradas
+bool TGARLEIndex::save(const char* filename) const {
+    if (!is_valid())
+        return false;
+    std::ofstream out(filename, std::ios::binary);
+    if (!out.is_open()) {
+        tga_log() << "can't open file " << filename << "\n";
+        return false;
+    }
+    std::int32_t fields[5] = { m_width, m_height, m_bytespp, m_step, m_descriptor };
+    std::uint64_t count = m_entries.size();
+    out.write(tga_index_magic, sizeof(tga_index_magic));
+    out.write((const char*)fields, sizeof(fields));
+    out.write((const char*)&m_file_size, sizeof(m_file_size));
+    out.write((const char*)&m_file_time, sizeof(m_file_time));
+    out.write((const char*)&count, sizeof(count));
+    for (const Entry& e : m_entries) {
+        out.write((const char*)&e.offset, sizeof(e.offset));
+        out.write((const char*)&e.skip, sizeof(e.skip));
+    }
+    if (!out.good()) {
+        tga_log() << "can't dump the index file\n";
+        return false;
+    }
+    return true;
+}
+
+bool TGARLEIndex::load(const char* filename, const char* tga_filename) {
+    m_entries.clear();
+    std::ifstream in(filename, std::ios::binary);
+    if (!in.is_open())
+        return false; // No es un error: el indice todavia no se ha creado
+    char magic[sizeof(tga_index_magic)];
+    std::int32_t fields[5];
+    std::uint64_t count = 0;
+    in.read(magic, sizeof(magic));
+    in.read((char*)fields, sizeof(fields));
+    in.read((char*)&m_file_size, sizeof(m_file_size));
+    in.read((char*)&m_file_time, sizeof(m_file_time));
+    in.read((char*)&count, sizeof(count));
+    if (!in.good() || std::memcmp(magic, tga_index_magic, sizeof(magic)) != 0 || fields[3] <= 0) {
+        tga_log() << "bad index file " << filename << "\n";
+        return false;
+    }
+    m_width = fields[0];
+    m_height = fields[1];
+    m_bytespp = fields[2];
+    m_step = fields[3];
+    m_descriptor = fields[4];
+    if (count != (std::uint64_t)(m_height + m_step - 1) / m_step) {
+        tga_log() << "bad index file " << filename << "\n";
+        return false;
+    }
+    if (!matches(tga_filename))
+        return false;
+    m_entries.resize(count);
+    for (Entry& e : m_entries) {
+        in.read((char*)&e.offset, sizeof(e.offset));
+        in.read((char*)&e.skip, sizeof(e.skip));
+    }
+    if (!in.good()) {
+        m_entries.clear();
+        tga_log() << "bad index file " << filename << "\n";
+        return false;
+    }
     return true;
 }
 
-bool TGAImage::load_rle_data(std::ifstream& in) {
-    unsigned long pixelcount = m_width * m_height; // Cantidad de pixeles en la imagen
-    unsigned long currentpixel = 0;                // Indice que representa el pixel actual
-    unsigned long currentbyte = 0;                 // Indice que representa el byte actual
-
-    TGAColor colorbuffer; // ...
-
-    do {
-        /*
-            En RLE (Run-Length-Encoded) en los .tga, hay paquetes que se conforman de 2 partes:
-            El primer byte representa la cantidad de veces que se repite un pixel, y los siguientes
-            la informacion del pixel (color), la cantidad de bytes de esa parte depende de bitsPerPixel.
-            Si el primer byte tiene el primer bit seteado (0b1000'0000), se llama Run-length packet y
-            los demás bits conforman la cantidad de pixeles a repetirse sumados con 1. Ver el manual de
-            Truevision. Por lo tanto 0b1111'1111(0xFF) represeta que el pixel se
-            repite 128 veces, y 0b1000'0011(0x83) que se repite 4 veces por ejemplo.
-            Se le resto 0b1000'0000(0x80) + 0x01 para determinar la cantidad de veces que se repite un pixel
-            Si el primer bit por el contrario es 0, se llama Raw packet(No RLE), los demas
-            bits representan la cantidad de pixeles que hay de ahi en adelante.
-        */
-        unsigned char chunkheader = 0; // Se toma como el Repetition-count-field (y como la veces que se repite)
-        chunkheader = in.get();        // Extrae un caracter (un byte)
-
-        if (!in.good()) { // Verifica que ninguna de las flags de error este seteada
-            std::cerr << "an error occured while reading the data\n";
+bool TGARLEIndex::matches(const char* tga_filename) const {
+    // Si el .tga cambio desde que se creo el indice, el indice ya no sirve
+    std::error_code ec;
+    return m_file_size == std::filesystem::file_size(tga_filename, ec) && m_file_time == tga_file_time(tga_filename);
+}
+
+bool TGAImage::read_tga_file_parallel(const char* filename, int nthreads, const char* index_filename) {
+    TGAFileBytes bytes; // Las bandas se decodifican directamente desde el archivo mapeado
+    if (!bytes.open(filename)) {
+        tga_log() << "can't open file " << filename << "\n";
+        return false;
+    }
+    if (bytes.size() < sizeof(TGA_Header)) {
+        tga_log() << "an error occured while reading the header\n";
+        return false;
+    }
+    TGA_Header header;
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    if (tga_is_expanded(header)) // Se expande fila por fila, ya con el archivo en memoria
+        return read_tga_memory(bytes.data(), bytes.size());
+    if (header.datatypecode != 10 && header.datatypecode != 11) // Sin RLE no hace falta indice
+        return read_tga_file(filename);
+    if (!tga_valid_rle_header(header))
+        return false;
+
+    int width = header.width;
+    int height = header.height;
+    int bytespp = header.bitsperpixel / 8;
+    TGARLEIndex index;
+    bool have_index = index_filename && index.load(index_filename, filename) && index.m_width == width &&
+                      index.m_height == height && index.m_bytespp == bytespp &&
+                      index.m_descriptor == (std::uint8_t)header.imagedescriptor;
+    if (!have_index) { // Pre-escaneo de los headers de los paquetes
+        std::size_t offset = tga_data_offset(header);
+        if (offset > bytes.size()) {
+            tga_log() << "an error occured while reading the data\n";
             return false;
         }
+        RLEMemoryReader src(bytes.data() + offset, bytes.size() - offset);
+        index.m_step = 16;
+        if (!scan_rle(src, offset, bytespp, width, height, index.m_step, index.m_entries))
+            return false;
+        index.m_width = width;
+        index.m_height = height;
+        index.m_bytespp = bytespp;
+        index.m_descriptor = (std::uint8_t)header.imagedescriptor;
+        index.m_file_size = bytes.size();
+        index.m_file_time = tga_file_time(filename);
+        if (index_filename)
+            index.save(index_filename);
+    }
 
-        if (chunkheader < 128) {                            // True si detecta que el primer bit NO esta seteado
-            chunkheader++;                                  // Se le aumenta uno para representar la cantidad de pixeles
-            for (int i = 0; i < chunkheader; i++) {         // Bucle que recorre pixel por pixel
-                in.read((char*)colorbuffer.raw, m_bytespp); // Se lee la informacion del pixel en el colorbuffer
-                if (!in.good()) {
-                    std::cerr << "an error occured while reading the header\n";
-                    return false;
-                }
-                for (int t = 0; t < m_bytespp; t++) // Se copia el colorbuffer a m_data
-                    m_data[currentbyte++] = colorbuffer.raw[t];
-                currentpixel++; // Una vez acabado el bucle, un pixel ya esta guardado en m_data
-                if (currentpixel > pixelcount) {
-                    std::cerr << "Too many pixels read\n";
-                    return false;
-                }
-            }
-        } else {                // De lo contrario el primer bit esta seteado (se lo considera un Run-length packet)
-            chunkheader -= 127; // Se le resta 128 y luego se suma 1 (seria -127) para representar la cantidad
-            in.read((char*)colorbuffer.raw, m_bytespp); // Se lee el pixel a repetirse
+    allocate(width, height, bytespp);
+
+    // Cada entrada del indice es una banda que se decodifica por separado
+    TGAStatTimer timer(TGA_STAT_DECODES, TGA_STAT_DECODE_NS);
+    std::size_t row_bytes = (std::size_t)m_width * m_bytespp;
+    bool bottom_up = !(header.imagedescriptor & 0x20);
+    bool right_to_left = header.imagedescriptor & 0x10;
+    int step = index.m_step;
+    int nbands = (int)index.m_entries.size();
+    std::atomic<bool> ok(true);
+    tga_parallel_for(nbands, nthreads, [&](int k) {
+        const TGARLEIndex::Entry& e = index.m_entries[k];
+        int y0 = k * step;
+        int y1 = std::min(m_height, y0 + step);
+        if (e.offset > bytes.size()) {
+            ok = false;
+            return;
+        }
+        RLEMemoryReader src(bytes.data() + e.offset, bytes.size() - e.offset);
+        unsigned long skip = e.skip;
+        // Misma correccion de orientacion que en read_tga_file(), fila por fila mientras se decodifica
+        if (!decode_rle_rows(src, m_bytespp, m_width, y1 - y0, &skip, right_to_left,
+                             [&](int i) { return m_data + (bottom_up ? m_height - 1 - y0 - i : y0 + i) * row_bytes; }))
+            ok = false;
+        else if (k == nbands - 1 && skip) { // La ultima banda tiene que terminar justo en el ultimo pixel
+            tga_log() << "Too many pixels read\n";
+            ok = false;
+        }
+    });
+    if (!ok) {
+        tga_log() << "an error occured while reading the data\n";
+        return false;
+    }
+    tga_stats_add(TGA_STAT_FILES_READ, 1);
+    tga_stats_add(TGA_STAT_BYTES_READ, bytes.size());
+    tga_log(TGA_LOG_INFO) << m_width << "x" << m_height << "/" << m_bytespp * 8 << " bits per pixel\n";
+    return true;
+}
+
+bool TGAImage::read_tga_rows(const char* filename, const TGARLEIndex& index, int y0, int y1) {
+    if (!index.is_valid() || y0 < 0 || y1 > index.m_height || y0 >= y1) {
+        tga_log() << "bad row range\n";
+        return false;
+    }
+    std::ifstream in;
+    in.open(filename, std::ios::binary);
+    if (!in.is_open()) {
+        tga_log() << "can't open file " << filename << "\n";
+        return false;
+    }
+    TGA_Header header;
+    in.read((char*)&header, sizeof(header));
+    if (!in.good()) {
+        tga_log() << "an error occured while reading the header\n";
+        return false;
+    }
+    // Un indice de otro archivo (o de una version anterior de este) llevaria a offsets que no son paquetes
+    if (!tga_valid_rle_header(header) || header.width != index.m_width || header.height != index.m_height ||
+        header.bitsperpixel / 8 != index.m_bytespp || (std::uint8_t)header.imagedescriptor != index.m_descriptor ||
+        !index.matches(filename)) {
+        tga_log() << "the index does not match " << filename << "\n";
+        return false;
+    }
+
+    // Filas del archivo que hacen falta: si el archivo esta de abajo hacia arriba se cuentan desde el final
+    bool bottom_up = !(index.m_descriptor & 0x20);
+    int fy0 = bottom_up ? index.m_height - y1 : y0;
+    int fy1 = bottom_up ? index.m_height - y0 : y1;
+    int k = fy0 / index.m_step; // Banda donde esta la primera fila
+    int start = k * index.m_step;
+    const TGARLEIndex::Entry& e = index.m_entries[k];
+
+    // Se decodifica desde el inicio de la banda y se detiene en la ultima fila pedida. Las filas anteriores a fy0
+    // se descartan en una fila auxiliar y las demas van directamente a su lugar en la imagen
+    allocate(index.m_width, y1 - y0, index.m_bytespp);
+    std::size_t row_bytes = (std::size_t)m_width * m_bytespp;
+    std::vector<unsigned char> scratch(row_bytes);
+    auto dst_row = [&](int i) {
+        int fr = start + i;
+        if (fr < fy0)
+            return scratch.data();
+        return m_data + (bottom_up ? fy1 - 1 - fr : fr - fy0) * row_bytes;
+    };
+    TGAStatTimer timer(TGA_STAT_DECODES, TGA_STAT_DECODE_NS);
+    in.seekg(e.offset);
+    RLEBlockReader src(in);
+    unsigned long skip = e.skip;
+    bool ok = decode_rle_rows(src, m_bytespp, m_width, fy1 - start, &skip, index.m_descriptor & 0x10, dst_row);
+    tga_stats_add(TGA_STAT_BYTES_READ, sizeof(header) + src.position());
+    if (ok && fy1 == index.m_height && skip) { // El ultimo paquete se pasa del final de la imagen
+        tga_log() << "Too many pixels read\n";
+        ok = false;
+    }
+    if (!ok) {
+        tga_log() << "an error occured while reading the data\n";
+        return false;
+    }
+    tga_stats_add(TGA_STAT_FILES_READ, 1);
+    return true;
+}
+
+bool TGAImage::read_tga_region(const char* filename, int x, int y, int w, int h) {
+    std::ifstream in;
+    in.open(filename, std::ios::binary);
+    if (!in.is_open()) {
+        tga_log() << "can't open file " << filename << "\n";
+        return false;
+    }
+    TGA_Header header;
+    in.read((char*)&header, sizeof(header));
+    if (!in.good()) {
+        tga_log() << "an error occured while reading the header\n";
+        return false;
+    }
+    int width = header.width;
+    int height = header.height;
+    int bytespp = header.bitsperpixel / 8;
+    if (width <= 0 || height <= 0 || (bytespp != GRAYSCALE && bytespp != RGB && bytespp != RGBA)) {
+        tga_log() << "bad bpp (or width/height) value\n";
+        return false;
+    }
+    bool rle = header.datatypecode == 10 || header.datatypecode == 11;
+    if (!rle && header.datatypecode != 2 && header.datatypecode != 3) {
+        tga_log() << "unknown file format " << (int)header.datatypecode << "\n";
+        return false;
+    }
+    if (x < 0 || y < 0 || w <= 0 || h <= 0 || w > width - x || h > height - y) {
+        tga_log() << "bad region\n";
+        return false;
+    }
 
+    // Se pasa la region a coordenadas del archivo segun los bits de origen del imagedescriptor
+    bool bottom_up = !(header.imagedescriptor & 0x20);
+    bool right_to_left = header.imagedescriptor & 0x10;
+    int fx0 = right_to_left ? width - x - w : x;
+    int fy0 = bottom_up ? height - y - h : y;
+    int fy1 = fy0 + h;
+
+    allocate(w, h, bytespp);
+    std::size_t region_row_bytes = (std::size_t)w * bytespp;
+    // Fila de la region donde va la fila fr del archivo, asi no hace falta voltear la region despues
+    auto dst_row = [&](int fr) { return m_data + (bottom_up ? fy1 - 1 - fr : fr - fy0) * region_row_bytes; };
+
+    std::size_t offset = tga_data_offset(header);
+    std::size_t file_row_bytes = (std::size_t)width * bytespp;
+    if (!rle) { // Sin comprimir: se lee solo el trozo de cada fila que hace falta
+        for (int fr = fy0; fr < fy1; fr++) {
+            in.seekg(offset + fr * file_row_bytes + fx0 * bytespp);
+            in.read((char*)dst_row(fr), region_row_bytes);
             if (!in.good()) {
-                std::cerr << "an error occured while reading the header\n";
+                tga_log() << "an error occured while reading the data\n";
                 return false;
             }
-
-            for (int i = 0; i < chunkheader; i++) { // Bucle que se repite la cantidad de pixeles a repetir
-                for (int t = 0; t < m_bytespp; t++) // Se copia del colorbuffer a m_data
-                    m_data[currentbyte++] = colorbuffer.raw[t];
-                currentpixel++; // Ya se leyo un pixel, por lo tanto se le aumenta
-                if (currentpixel > pixelcount) {
-                    std::cerr << "Too many pixels read\n";
-                    return false;
-                }
+        }
+        tga_stats_add(TGA_STAT_BYTES_READ, sizeof(header) + h * region_row_bytes);
+    } else { // Con RLE se decodifica fila por fila y se para despues de la ultima fila de la region
+        TGAStatTimer timer(TGA_STAT_DECODES, TGA_STAT_DECODE_NS);
+        in.seekg(offset);
+        RLEBlockReader src(in);
+        std::vector<unsigned char> row(file_row_bytes);
+        unsigned long skip = 0;
+        for (int fr = 0; fr < fy1; fr++) {
+            if (!decode_rle(bytespp, src, row.data(), width, skip, true, &skip)) {
+                tga_log() << "an error occured while reading the data\n";
+                return false;
             }
+            if (fr >= fy0)
+                std::memcpy(dst_row(fr), row.data() + fx0 * bytespp, region_row_bytes);
         }
-    } while (currentpixel < pixelcount);
+        tga_stats_add(TGA_STAT_BYTES_READ, offset + src.position());
+    }
+    tga_stats_add(TGA_STAT_FILES_READ, 1);
+    if (right_to_left) {
+        for (int j = 0; j < h; j++)
+            tga_reverse_pixels(m_data + j * region_row_bytes, w, bytespp);
+    }
     return true;
 }
 
-bool TGAImage::write_tga_file(const char* filename, bool rle) {
-    // Revisar el manual de Truevsion
-    // Se asignan la variables para el footer
-    /*
-        Bytes 0-3: The Extension Area Offset
-        Bytes 4-7: The Developer Directory Offset
-        Bytes 8-23: The Signature
-        Byte 24: ASCII Character “.”
-        Byte 25: Binary zero string terminator (0x00)
-    */
-    unsigned char developer_area_ref[4] = { 0, 0, 0, 0 };
-    unsigned char extension_area_ref[4] = { 0, 0, 0, 0 };
-    unsigned char footer[18] = { 'T', 'R', 'U', 'E', 'V', 'I', 'S', 'I', 'O',
-                                 'N', '-', 'X', 'F', 'I', 'L', 'E', '.', '\0' }; // byte 8 al 25
-
+bool TGAImage::write_tga_file(const char* filename, bool rle, int nthreads, Origin origin) {
     std::ofstream out;                    // Crea el archivo de salida
     out.open(filename, std::ios::binary); // Crea un archivo de nombre filename y lo abre en modo binario
 
     if (!out.is_open()) {
-        std::cerr << "can't open file " << filename << "\n";
+        tga_log() << "can't open file " << filename << "\n";
         out.close();
         return false;
     }
 
-    TGA_Header header;
-    std::memset((void*)&header, 0, sizeof(header)); // Reemplaza con 0x00 cada byte de header (que pesa 18 bytes)
-
-    // Se copian los valores trascendentes guardados de TGAImg al header creado
-    header.bitsperpixel = m_bytespp * 8; // m_bytespp << 3;
-    header.width = m_width;
-    header.height = m_height;
-    /*
-            0 no image data is present
-            1 uncompressed color-mapped image
-            2 uncompressed true-color image                         (***)
-            3 uncompressed black-and-white (grayscale) image        (***)
-            9 run-length encoded color-mapped image
-            10 run-length encoded true-color image                  (***)
-            11 run-length encoded black-and-white (grayscale) image (***)
-    */
-    header.datatypecode = (m_bytespp == GRAYSCALE ? (rle ? 11 : 3) : (rle ? 10 : 2));
-
-    // El origen siempre sera la esquina superior inzquierda
-    header.imagedescriptor = 0x20; // top-left origin 0b0010'0000
+    TGA_Header header = tga_make_header(m_width, m_height, m_bytespp, rle, origin);
 
     // Se Empieza a escribir el archivo
     out.write((char*)&header, sizeof(header));
     if (!out.good()) {
         out.close();
-        std::cerr << "can't dump the tga file\n";
+        tga_log() << "can't dump the tga file\n";
         return false;
     }
 
     if (!rle) { // Si no se escribe en RLE, simplemente se copia m_data al archivo
-        out.write((char*)m_data, m_width * m_height * m_bytespp);
+        if (origin == TOP_LEFT) {
+            out.write((char*)m_data, (std::streamsize)m_width * m_height * m_bytespp);
+        } else { // Las filas se arman en el orden del archivo en un buffer que se vuelca en bloques grandes
+            std::size_t row_bytes = (std::size_t)m_width * m_bytespp;
+            int band_rows = (int)std::max<std::size_t>(1, rle_flush_size / row_bytes);
+            std::vector<unsigned char> buf(band_rows * row_bytes);
+            for (int fr = 0; fr < m_height && out.good(); fr += band_rows) {
+                int n = std::min(band_rows, m_height - fr);
+                for (int i = 0; i < n; i++)
+                    tga_file_row(m_data, m_width, m_height, m_bytespp, origin, fr + i, buf.data() + i * row_bytes, true);
+                out.write((char*)buf.data(), n * row_bytes);
+            }
+        }
         if (!out.good()) {
-            std::cerr << "can't unload raw data\n";
+            tga_log() << "can't unload raw data\n";
             out.close();
             return false;
         }
     } else { // De lo contrario se ejecuta un algoritmo para codificar los Run-length packets
-        if (!unload_rle_data(out)) {
+        if (!unload_rle_data(out, nthreads, origin)) {
             out.close();
-            std::cerr << "can't unload rle data\n";
+            tga_log() << "can't unload rle data\n";
             return false;
         }
     }
 
     out.write((char*)developer_area_ref, sizeof(developer_area_ref));
     if (!out.good()) {
-        std::cerr << "can't dump the tga file\n";
+        tga_log() << "can't dump the tga file\n";
         out.close();
         return false;
     }
 
     out.write((char*)extension_area_ref, sizeof(extension_area_ref));
     if (!out.good()) {
-        std::cerr << "can't dump the tga file\n";
+        tga_log() << "can't dump the tga file\n";
         out.close();
         return false;
     }
 
     out.write((char*)footer, sizeof(footer));
     if (!out.good()) {
-        std::cerr << "can't dump the tga file\n";
+        tga_log() << "can't dump the tga file\n";
         out.close();
         return false;
     }
+    tga_stats_add(TGA_STAT_FILES_WRITTEN, 1);
+    tga_stats_add(TGA_STAT_BYTES_WRITTEN, (std::uint64_t)out.tellp());
     out.close();
     return true;
 }
 
-// TODO: it is not necessary to break a raw chunk for two equal pixels (for the matter of the resulting size)
-bool TGAImage::unload_rle_data(std::ofstream& out) {
-    const unsigned char max_chunk_length = 128; // Cantidad maxima de pixeles repetidos 0x7F + 0x1
-    unsigned long npixels = m_width * m_height; // Cantidad total de pixeles
-    unsigned long curpix = 0;                   // Current pixel | pixel actual
+namespace {
 
-    while (curpix < npixels) {
-        unsigned long chunkstart = curpix * m_bytespp;
-        unsigned long curbyte = curpix * m_bytespp;
-        unsigned char run_length = 1; // Cantidad de pixeles repetidos
-        bool raw = true; // Bandera que determina si es un Raw packet o un Run-length packet, ver manual de Truevision
+// Destino de los paquetes codificados cuando se escribe a un archivo: se juntan en buffer() y flush() los
+// vuelca en bloques grandes
+class RLEFileSink {
+    std::ofstream& m_out;
+    std::vector<unsigned char> m_buf;
 
-        while (curpix + run_length < npixels && run_length < max_chunk_length) {
-            bool succ_eq = true; // Successor equal | Si el siguiente pixel es igual
+public:
+    RLEFileSink(std::ofstream& out, std::size_t row_bytes) : m_out(out) {
+        m_buf.reserve(rle_flush_size + row_bytes + row_bytes / 128 + 1);
+    }
 
-            // Bucle que compara el pixel actual con el siguiente para ver si son iguales
-            for (int t = 0; succ_eq && (t < m_bytespp); t++) {
-                succ_eq = (m_data[curbyte + t] == m_data[curbyte + t + m_bytespp]);
-            }
+    std::vector<unsigned char>& buffer() { return m_buf; }
 
-            curbyte += m_bytespp; // Se pasa al primer byte del siguiente pixel
+    bool flush() {
+        if (!write(m_buf.data(), m_buf.size()))
+            return false;
+        m_buf.clear();
+        return true;
+    }
 
-            if (1 == run_length) { // Este if se da solo en la primera iteracion
-                raw = !succ_eq;
-            }
-            if (raw && succ_eq) { // True cuando los bytes son un Raw-packet y se topa un byte igual al ultimo recorrido
-                run_length--;
-                break;
+    bool write(const unsigned char* p, std::size_t n) {
+        m_out.write((const char*)p, n);
+        if (!m_out.good()) {
+            tga_log() << "can't dump the tga file\n";
+            return false;
+        }
+        return true;
+    }
+};
+
+// Misma interfaz, pero los paquetes quedan directamente al final de un buffer en memoria (sin copias extra)
+class RLEMemorySink {
+    std::vector<unsigned char>& m_out;
+
+public:
+    explicit RLEMemorySink(std::vector<unsigned char>& out) : m_out(out) {}
+
+    std::vector<unsigned char>& buffer() { return m_out; }
+    bool flush() { return true; }
+    bool write(const unsigned char* p, std::size_t n) {
+        m_out.insert(m_out.end(), p, p + n);
+        return true;
+    }
+};
+
+template <int BPP, class Sink>
+bool encode_rle(const unsigned char* data, int width, int height, int origin, Sink& sink) {
+    std::vector<unsigned char>& buf = sink.buffer();
+    std::vector<unsigned char> scratch(width * BPP);
+    for (int y = 0; y < height; y++) {
+        encode_rle_row<BPP>(tga_file_row(data, width, height, BPP, origin, y, scratch.data()), width, buf);
+        if (buf.size() >= rle_flush_size && !sink.flush())
+            return false;
+    }
+    return sink.flush();
+}
+
+// Version con varios hilos: como los paquetes no cruzan filas, cada banda de filas se codifica por separado
+// y las bandas se escriben en orden, el resultado es identico byte por byte al de encode_rle()
+template <int BPP, class Sink>
+bool encode_rle_parallel(const unsigned char* data, int width, int height, int origin, Sink& sink, int nthreads) {
+    std::size_t row_bytes = (std::size_t)width * BPP;
+    int band_rows = (int)std::max<std::size_t>(1, rle_flush_size / row_bytes); // Bandas de ~1 MiB sin comprimir
+    int nbands = (height + band_rows - 1) / band_rows;
+    // Se codifican nthreads bandas a la vez, asi la memoria usada no depende de la altura de la imagen
+    std::vector<std::vector<unsigned char>> bufs(nthreads);
+    std::vector<std::vector<unsigned char>> scratch(nthreads, std::vector<unsigned char>(row_bytes));
+    for (int first = 0; first < nbands; first += nthreads) {
+        int count = std::min(nthreads, nbands - first);
+        tga_parallel_for(count, nthreads, [&](int k) {
+            int y0 = (first + k) * band_rows;
+            int y1 = std::min(height, y0 + band_rows);
+            bufs[k].clear();
+            for (int y = y0; y < y1; y++)
+                encode_rle_row<BPP>(tga_file_row(data, width, height, BPP, origin, y, scratch[k].data()), width,
+                                    bufs[k]);
+        });
+        for (int k = 0; k < count; k++)
+            if (!sink.write(bufs[k].data(), bufs[k].size()))
+                return false;
+    }
+    return true;
+}
+
+template <int BPP, class Sink>
+bool encode_rle(const unsigned char* data, int width, int height, int origin, Sink& sink, int nthreads) {
+    nthreads = tga_resolve_threads(nthreads);
+    if (nthreads == 1)
+        return encode_rle<BPP>(data, width, height, origin, sink);
+    return encode_rle_parallel<BPP>(data, width, height, origin, sink, nthreads);
+}
+
+template <class Sink>
+bool encode_rle(const unsigned char* data, int width, int height, int bytespp, int origin, Sink& sink,
+                int nthreads) {
+    switch (bytespp) {
+    case TGAImage::GRAYSCALE:
+        return encode_rle<TGAImage::GRAYSCALE>(data, width, height, origin, sink, nthreads);
+    case TGAImage::RGB:
+        return encode_rle<TGAImage::RGB>(data, width, height, origin, sink, nthreads);
+    case TGAImage::RGBA:
+        return encode_rle<TGAImage::RGBA>(data, width, height, origin, sink, nthreads);
+    }
+    return false;
+}
+
+// Como encode_rle(), pero con la codificacion guardada en cache: solo se codifican las filas marcadas (repartidas
+// en nthreads hilos) y el archivo se arma copiando los paquetes de cada fila en el orden de origin
+template <class Sink>
+bool encode_rle_cached(TGARowCache& cache, const unsigned char* data, int width, int height, int bytespp, int origin,
+                       Sink& sink, int nthreads) {
+    bool reversed = origin & 0x10;
+    if (cache.width != width || cache.bytespp != bytespp || (int)cache.rows.size() != height ||
+        cache.reversed != reversed) { // Todo lo guardado es de otra imagen (u otro sentido horizontal)
+        cache.rows.assign(height, std::vector<unsigned char>());
+        cache.dirty.assign(height, 1);
+        cache.width = width;
+        cache.bytespp = bytespp;
+        cache.reversed = reversed;
+    }
+    std::vector<int> dirty;
+    for (int y = 0; y < height; y++)
+        if (cache.dirty[y])
+            dirty.push_back(y);
+    std::size_t row_bytes = (std::size_t)width * bytespp;
+    const int chunk_rows = 32;
+    int nchunks = ((int)dirty.size() + chunk_rows - 1) / chunk_rows;
+    tga_parallel_for(nchunks, nthreads, [&](int k) {
+        std::vector<unsigned char> scratch(reversed ? row_bytes : 0);
+        int i1 = std::min((int)dirty.size(), (k + 1) * chunk_rows);
+        for (int i = k * chunk_rows; i < i1; i++) {
+            int y = dirty[i];
+            const unsigned char* row = data + y * row_bytes;
+            if (reversed) {
+                tga_reverse_copy(scratch.data(), row, width, bytespp);
+                row = scratch.data();
             }
-            if (!raw && !succ_eq) { // True cuando NO es un Raw-packet y se topa un byte diferente al ultimo recorrido
-                break;
+            cache.rows[y].clear(); // Conserva la capacidad, la fila nueva suele ocupar lo mismo
+            encode_rle_row(bytespp, row, width, cache.rows[y]);
+            cache.dirty[y] = 0;
+        }
+    });
+    tga_stats_add(TGA_STAT_ROWS_REENCODED, dirty.size());
+    tga_stats_add(TGA_STAT_ROWS_REUSED, height - dirty.size());
+
+    std::vector<unsigned char>& buf = sink.buffer();
+    bool top_down = origin & 0x20;
+    for (int fr = 0; fr < height; fr++) {
+        const std::vector<unsigned char>& packets = cache.rows[top_down ? fr : height - 1 - fr];
+        buf.insert(buf.end(), packets.begin(), packets.end());
+        if (buf.size() >= rle_flush_size && !sink.flush())
+            return false;
+    }
+    return sink.flush();
+}
+
+// Agrega al final de out los pixeles tal como van en el archivo (sin header ni footer). Con cache (imagenes con
+// track_changes()) el RLE se arma con encode_rle_cached()
+bool tga_encode_data(const unsigned char* data, int width, int height, int bytespp, bool rle, int nthreads,
+                     int origin, std::vector<unsigned char>& out, TGARowCache* cache = nullptr) {
+    if (rle) {
+        TGAStatTimer timer(TGA_STAT_ENCODES, TGA_STAT_ENCODE_NS);
+        RLEMemorySink sink(out);
+        if (cache)
+            return encode_rle_cached(*cache, data, width, height, bytespp, origin, sink, nthreads);
+        return encode_rle(data, width, height, bytespp, origin, sink, nthreads);
+    }
+    std::size_t row_bytes = (std::size_t)width * bytespp;
+    std::size_t start = out.size();
+    out.resize(start + height * row_bytes);
+    for (int fr = 0; fr < height; fr++)
+        tga_file_row(data, width, height, bytespp, origin, fr, out.data() + start + fr * row_bytes, true);
+    return true;
+}
+
+} // namespace
+
+// Los paquetes se arman en un buffer en memoria y se escriben al archivo en bloques grandes
+bool TGAImage::unload_rle_data(std::ofstream& out, int nthreads, Origin origin) {
+    TGAStatTimer timer(TGA_STAT_ENCODES, TGA_STAT_ENCODE_NS);
+    RLEFileSink sink(out, (std::size_t)m_width * m_bytespp);
+    if (m_row_cache)
+        return encode_rle_cached(*m_row_cache, m_data, m_width, m_height, m_bytespp, origin, sink, nthreads);
+    return encode_rle(m_data, m_width, m_height, m_bytespp, origin, sink, nthreads);
+}
+
+bool TGAImage::read_tga_memory(const unsigned char* data, std::size_t size) {
+    release();
+    if (size < sizeof(TGA_Header)) {
+        tga_log() << "an error occured while reading the header\n";
+        return false;
+    }
+    TGA_Header header;
+    std::memcpy(&header, data, sizeof(header));
+    if (tga_is_expanded(header)) {
+        TGAStatTimer timer(TGA_STAT_DECODES, TGA_STAT_DECODE_NS);
+        RLEMemoryReader src(data + sizeof(header), size - sizeof(header));
+        bool ok = decode_expanded(src, header, m_allocator, *this);
+        tga_stats_add(TGA_STAT_BYTES_READ, sizeof(header) + src.position());
+        if (ok)
+            tga_log(TGA_LOG_INFO) << m_width << "x" << m_height << "/" << (int)header.bitsperpixel
+                                  << " bits per pixel (expanded to " << m_bytespp * 8 << ")\n";
+        return ok;
+    }
+    int width = header.width;
+    int height = header.height;
+    int bytespp = header.bitsperpixel / 8;
+    if (width <= 0 || height <= 0 || (bytespp != GRAYSCALE && bytespp != RGB && bytespp != RGBA)) {
+        tga_log() << "bad bpp (or width/height) value\n";
+        return false;
+    }
+    bool rle = header.datatypecode == 10 || header.datatypecode == 11;
+    if (!rle && header.datatypecode != 2 && header.datatypecode != 3) {
+        tga_log() << "unknown file format " << (int)header.datatypecode << "\n";
+        return false;
+    }
+    std::size_t offset = tga_data_offset(header);
+    std::size_t row_bytes = (std::size_t)width * bytespp;
+    if (offset > size || (!rle && (size - offset) / row_bytes < (std::size_t)height)) {
+        tga_log() << "an error occured while reading the data\n";
+        return false;
+    }
+
+    // Igual que en read_tga_file(): cada fila va directamente a su lugar segun el origen
+    allocate(width, height, bytespp);
+    bool bottom_up = !(header.imagedescriptor & 0x20);
+    bool right_to_left = header.imagedescriptor & 0x10;
+    auto dst_row = [&](int fr) { return m_data + (bottom_up ? m_height - 1 - fr : fr) * row_bytes; };
+    const unsigned char* pixels = data + offset;
+    std::size_t consumed = height * row_bytes;
+    if (!rle) {
+        for (int fr = 0; fr < height; fr++) {
+            std::memcpy(dst_row(fr), pixels + fr * row_bytes, row_bytes);
+            if (right_to_left)
+                tga_reverse_pixels(dst_row(fr), width, bytespp);
+        }
+    } else {
+        TGAStatTimer timer(TGA_STAT_DECODES, TGA_STAT_DECODE_NS);
+        RLEMemoryReader src(pixels, size - offset);
+        unsigned long skip = 0;
+        if (!decode_rle_rows(src, bytespp, width, height, &skip, right_to_left, dst_row)) {
+            tga_log() << "an error occured while reading the data\n";
+            return false;
+        }
+        if (skip) {
+            tga_log() << "Too many pixels read\n";
+            return false;
+        }
+        consumed = src.position();
+    }
+    tga_stats_add(TGA_STAT_BYTES_READ, offset + consumed);
+    tga_log(TGA_LOG_INFO) << m_width << "x" << m_height << "/" << m_bytespp * 8 << " bits per pixel\n";
+    return true;
+}
+
+bool TGAImage::write_tga_memory(std::vector<unsigned char>& out, bool rle, int nthreads, Origin origin) {
+    out.clear();
+    if (!m_data)
+        return false;
+    TGA_Header header = tga_make_header(m_width, m_height, m_bytespp, rle, origin);
+    // Sin RLE ya se conoce el tamanio final; con RLE se reserva lo mismo, que es el peor caso aproximado
+    out.reserve(sizeof(header) + (std::size_t)m_width * m_height * m_bytespp + sizeof(developer_area_ref) +
+                sizeof(extension_area_ref) + sizeof(footer));
+    out.insert(out.end(), (const unsigned char*)&header, (const unsigned char*)&header + sizeof(header));
+    if (!tga_encode_data(m_data, m_width, m_height, m_bytespp, rle, nthreads, origin, out, m_row_cache.get())) {
+        tga_log() << "can't unload rle data\n";
+        return false;
+    }
+    out.insert(out.end(), developer_area_ref, developer_area_ref + sizeof(developer_area_ref));
+    out.insert(out.end(), extension_area_ref, extension_area_ref + sizeof(extension_area_ref));
+    out.insert(out.end(), footer, footer + sizeof(footer));
+    tga_stats_add(TGA_STAT_BYTES_WRITTEN, out.size());
+    return true;
+}
+
+namespace {
+
+// Tabla de colores para write_tga_file_palette(): hash con direccionamiento abierto de hasta 256 colores
+class TGAPaletteBuilder {
+    static const int slots = 512; // El doble de colores posibles, las busquedas terminan rapido
+    std::uint32_t m_keys[slots];
+    int m_index[slots]; // -1: libre
+    std::vector<std::uint32_t> m_colors;
+
+public:
+    TGAPaletteBuilder() {
+        for (int i = 0; i < slots; i++)
+            m_index[i] = -1;
+    }
+
+    // Indice del color c (se agrega si es nuevo), -1 si ya hay 256 colores
+    int find(std::uint32_t c) {
+        unsigned h = (c * 2654435761u) >> 23; // 9 bits
+        while (m_index[h] >= 0 && m_keys[h] != c)
+            h = (h + 1) & (slots - 1);
+        if (m_index[h] < 0) {
+            if (m_colors.size() == 256)
+                return -1;
+            m_keys[h] = c;
+            m_index[h] = (int)m_colors.size();
+            m_colors.push_back(c);
+        }
+        return m_index[h];
+    }
+
+    const std::vector<std::uint32_t>& colors() const { return m_colors; }
+};
+
+} // namespace
+
+bool TGAImage::write_tga_file_palette(const char* filename, bool rle, int nthreads, Origin origin) const {
+    if (!m_data)
+        return false;
+    if (m_bytespp != RGB && m_bytespp != RGBA) {
+        tga_log() << "only RGB and RGBA images can be written with a colormap\n";
+        return false;
+    }
+    // Indices de todos los pixeles; se recuerda el ultimo color porque suele repetirse
+    std::size_t npixels = (std::size_t)m_width * m_height;
+    std::vector<unsigned char> indices(npixels);
+    TGAPaletteBuilder palette;
+    std::uint32_t last = 0;
+    int last_index = -1;
+    for (std::size_t i = 0; i < npixels; i++) {
+        std::uint32_t c = 0;
+        std::memcpy(&c, m_data + i * m_bytespp, m_bytespp);
+        if (last_index < 0 || c != last) {
+            last = c;
+            last_index = palette.find(c);
+            if (last_index < 0) {
+                tga_log() << "more than 256 colors, can't write a color-mapped file\n";
+                return false;
             }
-            run_length++;
         }
+        indices[i] = (unsigned char)last_index;
+    }
 
-        curpix += run_length;
-        out.put(raw ? run_length - 1 : run_length + 128 - 1);
+    TGA_Header header = tga_make_header(m_width, m_height, 1, rle, origin);
+    header.colormaptype = 1;
+    header.datatypecode = rle ? 9 : 1;
+    header.colormaporigin = 0;
+    header.colormaplength = (short)palette.colors().size();
+    header.colormapdepth = m_bytespp * 8;
+    std::vector<unsigned char> bytes;
+    bytes.insert(bytes.end(), (const unsigned char*)&header, (const unsigned char*)&header + sizeof(header));
+    for (std::uint32_t c : palette.colors())
+        bytes.insert(bytes.end(), (const unsigned char*)&c, (const unsigned char*)&c + m_bytespp);
+    if (!tga_encode_data(indices.data(), m_width, m_height, 1, rle, nthreads, origin, bytes)) {
+        tga_log() << "can't unload rle data\n";
+        return false;
+    }
+    bytes.insert(bytes.end(), developer_area_ref, developer_area_ref + sizeof(developer_area_ref));
+    bytes.insert(bytes.end(), extension_area_ref, extension_area_ref + sizeof(extension_area_ref));
+    bytes.insert(bytes.end(), footer, footer + sizeof(footer));
 
-        if (!out.good()) {
-            std::cerr << "can't dump the tga file\n";
+    std::ofstream out(filename, std::ios::binary);
+    if (!out.is_open()) {
+        tga_log() << "can't open file " << filename << "\n";
+        return false;
+    }
+    out.write((const char*)bytes.data(), bytes.size());
+    if (!out.good()) {
+        tga_log() << "can't dump the tga file\n";
+        return false;
+    }
+    tga_stats_add(TGA_STAT_FILES_WRITTEN, 1);
+    tga_stats_add(TGA_STAT_BYTES_WRITTEN, bytes.size());
+    return true;
+}
+
+bool TGAImage::write_tga_fd(int fd, bool rle, int nthreads, Origin origin) {
+#if !TGA_HAVE_WRITEV
+    (void)fd;
+    (void)rle;
+    (void)nthreads;
+    (void)origin;
+    tga_log() << "writing to a file descriptor is not supported on this platform\n";
+    return false;
+#else
+    if (!m_data)
+        return false;
+    TGA_Header header = tga_make_header(m_width, m_height, m_bytespp, rle, origin);
+    // Sin RLE y con el origen de m_data los pixeles se envian directamente desde m_data, sin copiarlos
+    const unsigned char* payload = m_data;
+    std::size_t payload_size = (std::size_t)m_width * m_height * m_bytespp;
+    std::vector<unsigned char> encoded;
+    if (rle || origin != TOP_LEFT) {
+        if (!tga_encode_data(m_data, m_width, m_height, m_bytespp, rle, nthreads, origin, encoded,
+                             m_row_cache.get())) {
+            tga_log() << "can't unload rle data\n";
             return false;
         }
+        payload = encoded.data();
+        payload_size = encoded.size();
+    }
 
-        out.write((char*)(m_data + chunkstart), (raw ? run_length * m_bytespp : m_bytespp));
-        if (!out.good()) {
-            std::cerr << "can't dump the tga file\n";
+    struct iovec iov[5] = {
+        { (void*)&header, sizeof(header) },
+        { (void*)payload, payload_size },
+        { (void*)developer_area_ref, sizeof(developer_area_ref) },
+        { (void*)extension_area_ref, sizeof(extension_area_ref) },
+        { (void*)footer, sizeof(footer) },
+    };
+    std::uint64_t total = 0;
+    int first = 0;
+    while (first < 5) { // writev() puede escribir menos de lo pedido (p. ej. en un pipe lleno), se sigue desde ahi
+        ssize_t n = ::writev(fd, iov + first, 5 - first);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            tga_log() << "can't dump the tga file\n";
             return false;
         }
+        total += n;
+        for (; first < 5 && (std::size_t)n >= iov[first].iov_len; first++)
+            n -= iov[first].iov_len;
+        if (first < 5) {
+            iov[first].iov_base = (char*)iov[first].iov_base + n;
+            iov[first].iov_len -= n;
+        }
     }
+    tga_stats_add(TGA_STAT_BYTES_WRITTEN, total);
     return true;
+#endif
 }
 
-TGAColor TGAImage::get(int x, int y) {
+// Cantidad de filas que procesa cada tarea cuando se voltea con varios hilos
+const int flip_band_rows = 64;
+
+TGAColor TGAImage::get(int x, int y) const {
     if (!m_data || x < 0 || y < 0 || x >= m_width || y >= m_height) {
         return TGAColor();
     }
     return TGAColor(m_data + (x + y * m_width) * m_bytespp, m_bytespp);
 }
 
+namespace {
+
+// Bytes de c en el formato de una imagen de bytespp bytes por pixel. Un color con bytespp que no es un formato
+// se copia tal cual
+inline void color_to_pixel(const TGAColor& c, int bytespp, unsigned char* pixel) {
+    if (c.bytespp == bytespp || (c.bytespp != TGAImage::GRAYSCALE && c.bytespp != TGAImage::RGB &&
+                                 c.bytespp != TGAImage::RGBA))
+        std::memcpy(pixel, c.raw, bytespp);
+    else
+        tga_convert_pixels(pixel, bytespp, c.raw, c.bytespp, 1);
+}
+
+// Convierte los pixeles de src a dst (del mismo tamanio) en bandas de filas repartidas en nthreads hilos
+void convert_image(TGAImage& dst, const TGAImage& src, int nthreads) {
+    int width = src.get_width();
+    int height = src.get_height();
+    int nbands = (height + flip_band_rows - 1) / flip_band_rows;
+    tga_parallel_for(nbands, nthreads, [&](int k) {
+        int j0 = k * flip_band_rows;
+        int j1 = std::min(height, j0 + flip_band_rows);
+        std::size_t first = (std::size_t)j0 * width; // Las bandas son bloques contiguos de pixeles
+        tga_convert_pixels(dst.buffer() + first * dst.get_bytespp(), dst.get_bytespp(),
+                           src.buffer() + first * src.get_bytespp(), src.get_bytespp(),
+                           (std::size_t)(j1 - j0) * width);
+    });
+}
+
+} // namespace
+
 bool TGAImage::set(int x, int y, TGAColor c) {
     if (!m_data || x < 0 || y < 0 || x >= m_width || y >= m_height) {
         return false;
     }
-    memcpy(m_data + (x + y * m_width) * m_bytespp, c.raw, m_bytespp);
+    color_to_pixel(c, m_bytespp, m_data + (x + y * m_width) * m_bytespp);
+    mark_dirty(y, y + 1);
     return true;
 }
 
-int TGAImage::get_bytespp() { return m_bytespp; }
+bool TGAImage::convert(Format format, int nthreads) {
+    if (!m_data || (format != GRAYSCALE && format != RGB && format != RGBA))
+        return false;
+    if (format == m_bytespp)
+        return true;
+    TGAImage converted(m_width, m_height, format, m_allocator, false);
+    convert_image(converted, *this, nthreads);
+    *this = std::move(converted);
+    return true;
+}
 
-int TGAImage::get_width() { return m_width; }
+bool TGAImage::write_tga_file(const char* filename, Format format, bool rle, int nthreads, Origin origin) {
+    if (!m_data || format == m_bytespp)
+        return write_tga_file(filename, rle, nthreads, origin);
+    if (format != GRAYSCALE && format != RGB && format != RGBA)
+        return false;
+    TGAImage converted(m_width, m_height, format, m_allocator, false);
+    convert_image(converted, *this, nthreads);
+    return converted.write_tga_file(filename, rle, nthreads, origin);
+}
 
-int TGAImage::get_height() { return m_height; }
+void TGAImage::fill(TGAColor c) {
+    if (!m_data)
+        return;
+    unsigned char pixel[4];
+    color_to_pixel(c, m_bytespp, pixel);
+    tga_fill_pixels(m_data, (std::size_t)m_width * m_height, pixel, m_bytespp); // Un solo bloque contiguo
+    mark_dirty();
+}
 
-bool TGAImage::flip_horizontally() {
-    if (!m_data) // True si m_data es nulo
+bool TGAImage::fill_rect(int x, int y, int w, int h, TGAColor c) {
+    if (!m_data)
         return false;
-    int half = m_width / 2; // Pixel de la mitad
-    for (int i = 0; i < half; i++) {
-        for (int j = 0; j < m_height; j++) {
-            // Se intercambian los pixeles del eje horizontal (i)
-            TGAColor c1 = get(i, j);
-            TGAColor c2 = get(m_width - 1 - i, j);
+    int x0 = std::max(x, 0), y0 = std::max(y, 0);
+    int x1 = (int)std::min<long long>((long long)x + w, m_width);
+    int y1 = (int)std::min<long long>((long long)y + h, m_height);
+    unsigned char pixel[4];
+    color_to_pixel(c, m_bytespp, pixel);
+    for (int j = y0; j < y1 && x0 < x1; j++)
+        tga_fill_pixels(m_data + ((std::size_t)j * m_width + x0) * m_bytespp, x1 - x0, pixel, m_bytespp);
+    if (x0 < x1)
+        mark_dirty(y0, y1);
+    return true;
+}
 
-            set(i, j, c2);
-            set(m_width - 1 - i, j, c1);
-        }
+namespace {
+
+// Recorta el rectangulo de w x h pixeles que va de (sx, sy) en src a (dx, dy) en dst para que quede dentro de
+// las dos imagenes. w o h < 0 llegan hasta el borde de src. false si no queda nada que copiar
+bool clip_blit(const TGAImage& src, const TGAImage& dst, int& dx, int& dy, int& sx, int& sy, int& w, int& h) {
+    if (w < 0)
+        w = src.get_width() - sx;
+    if (h < 0)
+        h = src.get_height() - sy;
+    // Primero el borde izquierdo/superior de cada imagen, lo que se recorta de un lado se corre en el otro
+    int cut = std::max({ 0, -sx, -dx });
+    sx += cut;
+    dx += cut;
+    w -= cut;
+    cut = std::max({ 0, -sy, -dy });
+    sy += cut;
+    dy += cut;
+    h -= cut;
+    w = std::min({ w, src.get_width() - sx, dst.get_width() - dx });
+    h = std::min({ h, src.get_height() - sy, dst.get_height() - dy });
+    return w > 0 && h > 0;
+}
+
+} // namespace
+
+bool TGAImage::blit(const TGAImage& src, int dx, int dy, int sx, int sy, int w, int h) {
+    if (!m_data || !src.m_data)
+        return false;
+    if (src.m_bytespp != m_bytespp) {
+        tga_log() << "blit: the images have different bytes per pixel\n";
+        return false;
+    }
+    if (!clip_blit(src, *this, dx, dy, sx, sy, w, h))
+        return true;
+    std::size_t row_bytes = (std::size_t)w * m_bytespp;
+    auto src_row = [&](int j) { return src.m_data + ((std::size_t)(sy + j) * src.m_width + sx) * m_bytespp; };
+    auto dst_row = [&](int j) { return m_data + ((std::size_t)(dy + j) * m_width + dx) * m_bytespp; };
+    if (&src != this) {
+        for (int j = 0; j < h; j++)
+            std::memcpy(dst_row(j), src_row(j), row_bytes);
+    } else if (dy > sy) { // Se copia desde abajo para no pisar filas que todavia no se copiaron
+        for (int j = h - 1; j >= 0; j--)
+            std::memmove(dst_row(j), src_row(j), row_bytes);
+    } else {
+        for (int j = 0; j < h; j++)
+            std::memmove(dst_row(j), src_row(j), row_bytes);
+    }
+    mark_dirty(dy, dy + h);
+    return true;
+}
+
+bool TGAImage::blend(const TGAImage& src, int dx, int dy, int sx, int sy, int w, int h) {
+    if (!m_data || !src.m_data)
+        return false;
+    if (src.m_bytespp != RGBA || (m_bytespp != RGB && m_bytespp != RGBA)) {
+        tga_log() << "blend: the source must be RGBA and the target RGB or RGBA\n";
+        return false;
     }
+    if (&src == this) { // Los rectangulos se pueden solapar, se compone desde una copia
+        TGAImage copy(src);
+        return blend(copy, dx, dy, sx, sy, w, h);
+    }
+    if (!clip_blit(src, *this, dx, dy, sx, sy, w, h))
+        return true;
+    for (int j = 0; j < h; j++)
+        tga_blend_pixels(m_data + ((std::size_t)(dy + j) * m_width + dx) * m_bytespp,
+                         src.m_data + ((std::size_t)(sy + j) * src.m_width + sx) * RGBA, w, m_bytespp);
+    mark_dirty(dy, dy + h);
     return true;
 }
 
-bool TGAImage::flip_vertically() {
+int TGAImage::get_bytespp() const { return m_bytespp; }
+
+int TGAImage::get_width() const { return m_width; }
+
+int TGAImage::get_height() const { return m_height; }
+
+bool TGAImage::flip_horizontally(int nthreads) {
+    if (!m_data) // True si m_data es nulo
+        return false;
+    TGAStatTimer timer(TGA_STAT_FLIPS, TGA_STAT_FLIP_NS);
+    // Se invierte cada fila por separado (acceso secuencial en memoria), las filas se reparten entre los hilos
+    std::size_t row_bytes = (std::size_t)m_width * m_bytespp;
+    int nbands = (m_height + flip_band_rows - 1) / flip_band_rows;
+    tga_parallel_for(nbands, nthreads, [&](int k) {
+        int y1 = std::min(m_height, (k + 1) * flip_band_rows);
+        for (int j = k * flip_band_rows; j < y1; j++)
+            tga_reverse_pixels(m_data + j * row_bytes, m_width, m_bytespp);
+    });
+    mark_dirty();
+    return true;
+}
+
+bool TGAImage::flip_vertically(int nthreads) {
     if (!m_data) // True si m_data es un puntero nulo
         return false;
+    TGAStatTimer timer(TGA_STAT_FLIPS, TGA_STAT_FLIP_NS);
 
-    unsigned long bytes_per_line = m_width * m_bytespp;      // Bytes por linea
-    unsigned char* line = new unsigned char[bytes_per_line]; // Funciona como un buffer
+    unsigned long bytes_per_line = m_width * m_bytespp; // Bytes por linea
     int half = m_height / 2;
-    for (int j = 0; j < half; j++) {
-        unsigned long l1 = j * bytes_per_line;
-        unsigned long l2 = (m_height - 1 - j) * bytes_per_line;
-
-        // Funcioa como un cambio de variable con una variable auxiliar
-        std::memmove((void*)line, (void*)(m_data + l1), bytes_per_line);
-        std::memmove((void*)(m_data + l1), (void*)(m_data + l2), bytes_per_line);
-        std::memmove((void*)(m_data + l2), (void*)line, bytes_per_line);
-    }
-    delete[] line;
+    int nbands = (half + flip_band_rows - 1) / flip_band_rows;
+    tga_parallel_for(nbands, nthreads, [&](int k) {
+        int j1 = std::min(half, (k + 1) * flip_band_rows);
+        for (int j = k * flip_band_rows; j < j1; j++) {
+            unsigned long l1 = j * bytes_per_line;
+            unsigned long l2 = (m_height - 1 - j) * bytes_per_line;
+            // Se intercambian las dos filas directamente, sin una fila auxiliar
+            tga_swap_bytes(m_data + l1, m_data + l2, bytes_per_line);
+        }
+    });
+    mark_dirty();
     return true;
 }
 
 unsigned char* TGAImage::buffer() { return m_data; }
 
-void TGAImage::clear() { memset((void*)m_data, 0, m_width * m_height * m_bytespp); }
+const unsigned char* TGAImage::buffer() const { return m_data; }
+
+void TGAImage::clear() {
+    memset((void*)m_data, 0, (std::size_t)m_width * m_height * m_bytespp);
+    mark_dirty();
+}
 
 bool TGAImage::scale(int w, int h) {
     if (w <= 0 || h <= 0 || !m_data) // Controla si la altura o el ancho es menor a 0, o si m_data es nulo
         return false;
 
-    unsigned char* tdata = new unsigned char[w * h * m_bytespp]; // como m_data pero con las nuevas dimensionesX
+    TGAStatTimer timer(TGA_STAT_SCALES, TGA_STAT_SCALE_NS);
+    // como m_data pero con las nuevas dimensionesX
+    unsigned char* tdata = m_allocator->allocate((std::size_t)w * h * m_bytespp);
+    tga_stats_add(TGA_STAT_ALLOCATIONS, 1);
+    tga_stats_add(TGA_STAT_ALLOCATED_BYTES, (std::size_t)w * h * m_bytespp);
     int nscanline = 0;                                           // New scan line
     int oscanline = 0;                                           // Original scan line
     int erry = 0;                                                // Error en Y
@@ -452,9 +1698,10 @@ bool TGAImage::scale(int w, int h) {
         }
     }
 
-    delete[] m_data;
+    release();
     m_data = tdata;
     m_width = w;
     m_height = h;
+    mark_dirty();
     return true;
 }
\ No newline at end of file
@@ -1,8 +1,13 @@
 #ifndef __IMAGE_H__
 #define __IMAGE_H__
 
+#include <cstddef> // Para utilizar std::size_t
+#include <cstdint> // Para utilizar std::uint64_t
 #include <cstring> // Para utilizar std::memcpy()
 #include <fstream> // Para utilizar std::ifstream y std::ofstream
+#include <memory>  // Para utilizar std::unique_ptr
+#include <mutex>   // Para utilizar std::mutex
+#include <vector>
 
 #pragma pack(push, 1) // Le dice al compilador que guarde los datos para un maximo de 1 byte
 
@@ -17,8 +22,8 @@ struct TGA_Header {
 	std::int8_t colormapdepth;
 	short x_origin;
 	short y_origin;
-	short width;
-	short height;
+	unsigned short width; // Sin signo: el formato admite hasta 65535 pixeles
+	unsigned short height;
 	std::int8_t bitsperpixel;
 	std::int8_t imagedescriptor;
 };
@@ -59,6 +64,101 @@ struct TGAColor {
 	}
 };
 
+// Indice de los paquetes de un .tga con RLE: cada step filas (en el orden en que estan en el archivo) guarda
+// en que byte empieza el paquete que contiene el primer pixel de esa fila. Con el indice se pueden
+// decodificar bandas de filas en paralelo o solo algunas filas sin recorrer todo el archivo.
+// Se puede guardar en un archivo aparte (sidecar) para no tener que volver a escanear el .tga
+class TGARLEIndex {
+public:
+	struct Entry {
+		std::uint64_t offset; // Byte del archivo donde empieza el paquete
+		std::uint32_t skip;   // Pixeles de ese paquete que pertenecen a filas anteriores
+	};
+
+protected:
+	std::vector<Entry> m_entries;
+	int m_width;
+	int m_height;
+	int m_bytespp;
+	int m_step;                // Filas entre dos entradas del indice
+	int m_descriptor;          // imagedescriptor del header (orientacion)
+	std::uint64_t m_file_size; // Tamanio y fecha de modificacion del .tga, para saber si el indice sigue valido
+	std::int64_t m_file_time;
+
+public:
+	TGARLEIndex();
+
+	bool build(const char* filename, int step = 16); // Escanea los headers de los paquetes del archivo
+	bool save(const char* filename) const;
+	// Carga un indice guardado con save(), retorna false si no corresponde a tga_filename tal como esta ahora
+	bool load(const char* filename, const char* tga_filename);
+	// true si el tamanio y la fecha de modificacion de tga_filename son los mismos que cuando se creo el indice
+	bool matches(const char* tga_filename) const;
+	bool is_valid() const { return !m_entries.empty(); }
+
+	const std::vector<Entry>& entries() const { return m_entries; }
+	int get_width() const { return m_width; }
+	int get_height() const { return m_height; }
+	int get_bytespp() const { return m_bytespp; }
+	int get_step() const { return m_step; }
+	int get_descriptor() const { return m_descriptor; }
+
+	friend class TGAImage; // read_tga_file_parallel() llena el indice mientras lee el archivo
+};
+
+// Interfaz para reservar los buffers de pixeles de TGAImage. El allocator tiene que existir mientras existan
+// las imagenes que lo usan
+class TGAAllocator {
+public:
+	virtual ~TGAAllocator() {}
+	virtual unsigned char* allocate(std::size_t nbytes) = 0;
+	virtual void deallocate(unsigned char* p, std::size_t nbytes) = 0;
+};
+
+// Allocator por defecto: buffers alineados a alignment bytes (64, una linea de cache, sirve para SIMD)
+class TGAAlignedAllocator : public TGAAllocator {
+protected:
+	std::size_t m_alignment;
+
+public:
+	explicit TGAAlignedAllocator(std::size_t alignment = 64) : m_alignment(alignment) {}
+	unsigned char* allocate(std::size_t nbytes) override;
+	void deallocate(unsigned char* p, std::size_t nbytes) override;
+};
+
+// Allocator que usan las imagenes si no se indica otro
+TGAAllocator* tga_default_allocator();
+
+// Pool de buffers para render targets de tamanio fijo: los buffers liberados se guardan y se vuelven a entregar
+// al pedir el mismo tamanio, asi renderizar cuadros del mismo tamanio no hace reservas en el heap.
+// Se puede usar desde varios hilos
+class TGAFramePool : public TGAAllocator {
+protected:
+	struct Block {
+		unsigned char* data;
+		std::size_t nbytes;
+	};
+	TGAAlignedAllocator m_base;  // De donde salen los buffers nuevos
+	std::vector<Block> m_free;   // Buffers liberados listos para reutilizarse
+	std::size_t m_max_free;      // Cantidad maxima de buffers guardados
+	std::size_t m_heap_allocs;   // Cantidad de reservas que llegaron al heap
+	mutable std::mutex m_mutex;
+
+public:
+	explicit TGAFramePool(std::size_t max_free = 8, std::size_t alignment = 64);
+	~TGAFramePool();
+	TGAFramePool(const TGAFramePool&) = delete;
+	TGAFramePool& operator=(const TGAFramePool&) = delete;
+
+	unsigned char* allocate(std::size_t nbytes) override;
+	void deallocate(unsigned char* p, std::size_t nbytes) override;
+	void trim(); // Devuelve al heap todos los buffers guardados
+	std::size_t heap_allocations() const;
+};
+
+// Codificacion RLE de cada fila guardada entre escrituras (ver TGAImage::track_changes()), definida en tgaimage.cpp
+struct TGARowCache;
+
 // Clase que engloba representa una imagen .tga, capaz de generar un archivo de salidad .tga
 class TGAImage {
 protected:               // Los elementos pueden ser accedidos por miembros de TGAImage, friends y clases hijas
@@ -66,42 +166,120 @@ protected:               // Los elementos pueden ser accedidos por miembros de T
 	int m_width;           // Ancho en pixeles
 	int m_height;          // Altura en pixeles
 	int m_bytespp;         // Bytes por pixel
+	TGAAllocator* m_allocator; // De donde sale m_data
+	std::unique_ptr<TGARowCache> m_row_cache; // Solo con track_changes(true)
 
-	bool load_rle_data(std::ifstream& in);    // Lee los datos del header y los guarda en la referencia in
-	bool unload_rle_data(std::ofstream& out); // Vuelca los datos de la imagen .tga en el la refernecia out
+	// Reserva m_data para una imagen de w x h pixeles (liberando el anterior), con ceros si zeroed es true
+	void allocate(int w, int h, int bpp, bool zeroed = false);
+	void release(); // Libera m_data
 
 public:
 	enum Format { GRAYSCALE = 1, RGB = 3, RGBA = 4 }; // Representan los bits por pixel
 
+	// Origen de la imagen en el archivo, con los mismos bits que TGA_Header::imagedescriptor
+	enum Origin { BOTTOM_LEFT = 0x00, BOTTOM_RIGHT = 0x10, TOP_LEFT = 0x20, TOP_RIGHT = 0x30 };
+
+protected:
+	// Lee los datos del header y los guarda en la referencia in, ordenando las filas segun imagedescriptor
+	bool load_rle_data(std::ifstream& in, int imagedescriptor = TOP_LEFT);
+	// Vuelca los datos de la imagen .tga en el la refernecia out, con nthreads hilos (<= 0: todos los nucleos)
+	bool unload_rle_data(std::ofstream& out, int nthreads = 1, Origin origin = TOP_LEFT);
+
+public:
 	// Constructurores
 
 	//Constructor por defecto: Inicializa todo con 0 y data con nullptr
 	TGAImage();
 
-	// Inicializa data con un arreglo de tamanio w * t * bpp
-	TGAImage(int w, int h, int bpp);
+	// Inicializa data con un arreglo de tamanio w * t * bpp. allocator == nullptr usa tga_default_allocator().
+	// Con zeroed = false no se llenan los bytes con 0 (para imagenes que se van a sobreescribir completas)
+	TGAImage(int w, int h, int bpp, TGAAllocator* allocator = nullptr, bool zeroed = true);
 
-	// Constructor de
+	// Constructor de copia, usa el mismo allocator que img
 	TGAImage(const TGAImage& img);
 
+	// Constructor de movimiento: se queda con el buffer de img sin copiarlo, img queda vacia
+	TGAImage(TGAImage&& img) noexcept;
+
 	// Reasinacion del operador de asignacion
 	TGAImage& operator=(const TGAImage& img);
+	TGAImage& operator=(TGAImage&& img) noexcept;
 	// De aqui en adelante los metodos hacen los que dice su nombre literalmente
 
+	// Ademas de los tipos 2, 3, 10 y 11 lee archivos color-mapped (tipos 1 y 9) y de 15/16 bits, que se expanden a
+	// RGB o RGBA (RGBA si los colores tienen alpha)
 	bool read_tga_file(const char* filename);
-	bool write_tga_file(const char* filename, bool rle = true);
-	bool flip_horizontally();
-	bool flip_vertically();
-	bool scale(int w, int h); // !Sinceramente no se lo que hace
-	TGAColor get(int x, int y);
+	// Lee el archivo y convierte los pixeles a format, sea cual sea el formato del archivo
+	bool read_tga_file(const char* filename, Format format);
+	// Lee un .tga decodificando bandas de filas en nthreads hilos (<= 0: todos los nucleos). Si index_filename
+	// no es nullptr se usa ese indice, y si no existe o ya no corresponde al archivo se crea de nuevo
+	bool read_tga_file_parallel(const char* filename, int nthreads = 0, const char* index_filename = nullptr);
+	// Decodifica solo las filas [y0, y1) (con el origen arriba a la izquierda, como despues de read_tga_file)
+	bool read_tga_rows(const char* filename, const TGARLEIndex& index, int y0, int y1);
+	// Lee solo el rectangulo de w x h pixeles con esquina superior izquierda en (x, y), sin cargar toda la imagen
+	bool read_tga_region(const char* filename, int x, int y, int w, int h);
+	// nthreads: hilos para codificar en RLE (<= 0: todos los nucleos), el archivo es el mismo con cualquier valor.
+	// origin: orientacion con la que se guardan las filas, se aplica al escribir sin voltear m_data
+	bool write_tga_file(const char* filename, bool rle = true, int nthreads = 1, Origin origin = TOP_LEFT);
+	// Guarda el archivo con los pixeles convertidos a format (la imagen no cambia)
+	bool write_tga_file(const char* filename, Format format, bool rle = true, int nthreads = 1,
+	                    Origin origin = TOP_LEFT);
+	// Guarda un .tga color-mapped (tipo 9 con RLE, 1 sin RLE): un indice de 8 bits por pixel y un colormap con los
+	// colores de la imagen (de 24 o 32 bits). Solo para imagenes RGB o RGBA de hasta 256 colores; con mas colores
+	// retorna false sin crear el archivo, y se puede guardar con write_tga_file()
+	bool write_tga_file_palette(const char* filename, bool rle = true, int nthreads = 1, Origin origin = TOP_LEFT) const;
+	// Igual que read_tga_file(), pero el .tga ya esta en memoria (recibido por un pipe, un socket, etc.)
+	bool read_tga_memory(const unsigned char* data, std::size_t size);
+	// Igual que write_tga_file(), pero el .tga completo queda en out (se reemplaza su contenido, no su capacidad,
+	// asi un mismo buffer sirve para todos los cuadros)
+	bool write_tga_memory(std::vector<unsigned char>& out, bool rle = true, int nthreads = 1,
+	                      Origin origin = TOP_LEFT);
+	// Escribe el .tga en un descriptor (pipe, socket, archivo) con writev(): header, pixeles, referencias y footer
+	// salen en una sola llamada al sistema. Sin RLE y con origin = TOP_LEFT los pixeles se envian sin copiarlos
+	bool write_tga_fd(int fd, bool rle = true, int nthreads = 1, Origin origin = TOP_LEFT);
+	// nthreads: hilos que reparten las filas (<= 0: todos los nucleos)
+	bool flip_horizontally(int nthreads = 1);
+	bool flip_vertically(int nthreads = 1);
+	// Vecino mas cercano (rapido pero con aliasing al reducir); para filtros de calidad ver tga_resample()
+	bool scale(int w, int h);
+	// Convierte los pixeles a format (ver tga_convert_pixels() en tgakernels.h: de gris a color se repite el
+	// valor, el alpha que falta es 255 y de color a gris se usa la luma). Las filas se reparten en nthreads hilos
+	bool convert(Format format, int nthreads = 1);
+	TGAColor get(int x, int y) const;
+	// Si c.bytespp no es el de la imagen, c se convierte igual que en convert()
 	bool set(int x, int y, TGAColor c);
+	// Llena toda la imagen con c (convertido como en set())
+	void fill(TGAColor c);
+	// Llena el rectangulo de w x h pixeles con esquina superior izquierda en (x, y), recortado a la imagen
+	bool fill_rect(int x, int y, int w, int h, TGAColor c);
+	// Copia el rectangulo de w x h pixeles de src con esquina en (sx, sy) a (dx, dy) de esta imagen, recortado a
+	// las dos imagenes (w o h < 0: hasta el borde de src). src tiene que tener los mismos bytes por pixel y puede
+	// ser esta misma imagen, aunque los rectangulos se solapen
+	bool blit(const TGAImage& src, int dx, int dy, int sx = 0, int sy = 0, int w = -1, int h = -1);
+	// Como blit(), pero src (RGBA) se compone sobre esta imagen (RGB o RGBA) segun su alpha:
+	// color = (src * a + dst * (255 - a)) / 255, y si esta imagen es RGBA, alpha = a + dst_a * (255 - a) / 255
+	bool blend(const TGAImage& src, int dx, int dy, int sx = 0, int sy = 0, int w = -1, int h = -1);
 	~TGAImage();
-	int get_width();
-	int get_height();
-	int get_bytespp();
+	int get_width() const;
+	int get_height() const;
+	int get_bytespp() const;
+	TGAAllocator* get_allocator() const { return m_allocator; } // El que reserva (y libera) m_data
+
+	// Seguimiento de cambios para escribir cuadros sucesivos: la imagen guarda la codificacion RLE de cada fila y
+	// anota que filas cambian con set(), fill(), fill_rect(), blit(), blend(), los flips, etc. Al escribir con RLE
+	// solo se codifican de nuevo esas filas y el resto del archivo se arma con las filas guardadas, asi el costo
+	// es proporcional a lo que cambio. Lo que se escribe directamente en buffer() (o con una vista) se tiene que
+	// anotar con mark_dirty(). Es una propiedad del objeto: las copias no la heredan y al asignarle otra imagen
+	// se marcan todas las filas. Escribir una imagen con seguimiento actualiza su cache, por eso write_tga_file(),
+	// write_tga_memory() y write_tga_fd() no son const
+	void track_changes(bool enable = true);
+	bool is_tracking_changes() const { return m_row_cache != nullptr; }
+	void mark_dirty(int y0, int y1); // Las filas [y0, y1) cambiaron
+	void mark_dirty() { mark_dirty(0, m_height); }
 
 	// Retornar data
 	unsigned char* buffer();
+	const unsigned char* buffer() const;
 	void clear();
 };
 
@@ -0,0 +1,615 @@
+#include "tgakernels.h"
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h> // Intrinsics SSE2
+#endif
+#if defined(__SSSE3__)
+#include <tmmintrin.h> // Intrinsics SSSE3 (_mm_shuffle_epi8)
+#endif
+
+// Con GCC o Clang en x86 las rutas de extensiones mas nuevas que la base (SSSE3, AVX2) se compilan siempre, con el
+// atributo target, y se eligen al ejecutar segun la CPU. Asi el binario no necesita -mssse3 ni -mavx2 y sigue
+// funcionando en una CPU sin esas instrucciones
+#if defined(__SSE2__) && (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define TGA_HAVE_DISPATCH 1
+#define TGA_TARGET(isa) __attribute__((target(isa)))
+#include <immintrin.h> // Intrinsics SSSE3 y AVX2 (_mm_shuffle_epi8, _mm256_i32gather_epi32)
+#else
+#define TGA_HAVE_DISPATCH 0
+#endif
+
+namespace {
+
+#if TGA_HAVE_DISPATCH
+// Se consulta la CPU una sola vez; si el compilador ya puede usar la extension no hace falta preguntar
+inline bool cpu_has_ssse3() {
+#if defined(__SSSE3__)
+    return true;
+#else
+    static const bool has = (__builtin_cpu_init(), __builtin_cpu_supports("ssse3"));
+    return has;
+#endif
+}
+
+inline bool cpu_has_avx2() {
+#if defined(__AVX2__)
+    return true;
+#else
+    static const bool has = (__builtin_cpu_init(), __builtin_cpu_supports("avx2"));
+    return has;
+#endif
+}
+#endif
+
+#if defined(__SSE2__)
+// Invierte el orden de los pixeles dentro de un bloque de 16 bytes (los de 3 bytes van aparte, con SSSE3)
+template <int BPP> inline __m128i reverse_block(__m128i v);
+
+template <> inline __m128i reverse_block<4>(__m128i v) { return _mm_shuffle_epi32(v, 0x1B); }
+
+template <> inline __m128i reverse_block<1>(__m128i v) {
+#if defined(__SSSE3__)
+    return _mm_shuffle_epi8(v, _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0));
+#else
+    // Se invierten los bloques de 4 bytes, luego los de 2 bytes dentro de cada uno y luego los bytes
+    v = _mm_shuffle_epi32(v, 0x1B);
+    v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, 0xB1), 0xB1);
+    return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+#endif
+}
+
+#endif
+
+#if TGA_HAVE_DISPATCH
+// Con 3 bytes por pixel el bloque tiene 5 pixeles (15 bytes) y el byte 15 no se usa. SSE2 solo no tiene
+// shuffle de bytes, sin SSSE3 los pixeles de 3 bytes se invierten de a uno
+TGA_TARGET("ssse3") inline __m128i reverse_block3(__m128i v) {
+    return _mm_shuffle_epi8(v, _mm_setr_epi8(12, 13, 14, 9, 10, 11, 6, 7, 8, 3, 4, 5, 0, 1, 2, -1));
+}
+
+// Parte vectorial de reverse_pixels<3>(): intercambia un bloque de cada extremo mientras queden dos bloques.
+// Retorna cuantos pixeles de cada extremo quedaron en su lugar
+TGA_TARGET("ssse3") int reverse_pixels3_ssse3(unsigned char* row, int n) {
+    int i = 0;
+    int j = n;
+    while (j - i >= 10) {
+        unsigned char* left = row + i * 3;
+        unsigned char* right = row + (j - 5) * 3;
+        __m128i l = _mm_loadu_si128((const __m128i*)left);
+        // Se lee desde un byte antes para no pasarse del final de la fila y se corre un byte
+        __m128i r = _mm_srli_si128(_mm_loadu_si128((const __m128i*)(right - 1)), 1);
+        unsigned char tl[16], tr[16]; // Solo se escriben 15 bytes para no pisar el pixel siguiente
+        _mm_storeu_si128((__m128i*)tl, reverse_block3(r));
+        _mm_storeu_si128((__m128i*)tr, reverse_block3(l));
+        std::memcpy(left, tl, 15);
+        std::memcpy(right, tr, 15);
+        i += 5;
+        j -= 5;
+    }
+    return i;
+}
+
+// Parte vectorial de reverse_copy<3>(), retorna cuantos pixeles copio. Se lee un byte de mas, por eso el ultimo
+// bloque queda para el bucle escalar
+TGA_TARGET("ssse3") int reverse_copy3_ssse3(unsigned char* dst, const unsigned char* src, int n) {
+    int i = 0;
+    for (; i + 6 <= n; i += 5) {
+        // El bloque empieza un byte antes, se corre un byte para alinear los pixeles
+        __m128i v = _mm_srli_si128(_mm_loadu_si128((const __m128i*)(src + (n - i - 5) * 3 - 1)), 1);
+        unsigned char t[16];
+        _mm_storeu_si128((__m128i*)t, reverse_block3(v));
+        std::memcpy(dst + i * 3, t, 15);
+    }
+    return i;
+}
+#endif
+
+// Guarda 4 pixeles BGRA de t como pixeles de 3 bytes: se copian de a 4 bytes (el cuarto se pisa con el pixel
+// siguiente) menos el ultimo, asi no se escribe despues de los 12 bytes
+inline void store_rgb_block(unsigned char* dst, const std::uint32_t* t) {
+    std::memcpy(dst, &t[0], 4);
+    std::memcpy(dst + 3, &t[1], 4);
+    std::memcpy(dst + 6, &t[2], 4);
+    std::memcpy(dst + 9, &t[3], 3);
+}
+
+inline void swap_pixel(unsigned char* a, unsigned char* b, int bpp) {
+    unsigned char tmp[4];
+    std::memcpy(tmp, a, bpp);
+    std::memcpy(a, b, bpp);
+    std::memcpy(b, tmp, bpp);
+}
+
+template <int BPP> void reverse_pixels(unsigned char* row, int n) {
+    int i = 0; // Primer pixel de la parte izquierda que falta invertir
+    int j = n; // Uno mas que el ultimo pixel de la parte derecha que falta invertir
+#if TGA_HAVE_DISPATCH
+    if constexpr (BPP == 3) {
+        if (cpu_has_ssse3()) {
+            i = reverse_pixels3_ssse3(row, n);
+            j = n - i;
+        }
+    }
+#endif
+#if defined(__SSE2__)
+    if constexpr (BPP != 3) {
+        const int ppb = 16 / BPP; // Pixeles por bloque
+        // Se cargan un bloque de cada extremo, se invierten y se guardan intercambiados
+        while (j - i >= 2 * ppb) {
+            unsigned char* left = row + i * BPP;
+            unsigned char* right = row + (j - ppb) * BPP;
+            __m128i l = _mm_loadu_si128((const __m128i*)left);
+            __m128i r = _mm_loadu_si128((const __m128i*)right);
+            _mm_storeu_si128((__m128i*)left, reverse_block<BPP>(r));
+            _mm_storeu_si128((__m128i*)right, reverse_block<BPP>(l));
+            i += ppb;
+            j -= ppb;
+        }
+    }
+#endif
+    for (j--; i < j; i++, j--)
+        swap_pixel(row + i * BPP, row + j * BPP, BPP);
+}
+
+template <int BPP> void reverse_copy(unsigned char* dst, const unsigned char* src, int n) {
+    int i = 0;
+#if TGA_HAVE_DISPATCH
+    if constexpr (BPP == 3) {
+        if (cpu_has_ssse3())
+            i = reverse_copy3_ssse3(dst, src, n);
+    }
+#endif
+#if defined(__SSE2__)
+    if constexpr (BPP != 3) {
+        const int ppb = 16 / BPP;
+        for (; i + ppb <= n; i += ppb) {
+            __m128i v = _mm_loadu_si128((const __m128i*)(src + (n - i - ppb) * BPP));
+            _mm_storeu_si128((__m128i*)(dst + i * BPP), reverse_block<BPP>(v));
+        }
+    }
+#endif
+    for (; i < n; i++)
+        std::memcpy(dst + i * BPP, src + (n - 1 - i) * BPP, BPP);
+}
+
+// x / 255 redondeado, exacto para x <= 255 * 255
+inline std::uint8_t div255(unsigned x) {
+    x += 128;
+    return (std::uint8_t)((x + (x >> 8)) >> 8);
+}
+
+// Compone un pixel RGBA de src sobre dst
+template <int DST_BPP> inline void blend_pixel(unsigned char* dst, const unsigned char* src) {
+    unsigned a = src[3];
+    for (int ch = 0; ch < 3; ch++)
+        dst[ch] = div255(src[ch] * a + dst[ch] * (255 - a));
+    if (DST_BPP == 4)
+        dst[3] = div255(a * 255 + dst[3] * (255 - a));
+}
+
+#if defined(__SSE2__)
+// Compone 4 pixeles RGBA de s sobre 4 pixeles RGBA de d, con la misma cuenta que blend_pixel() en 16 bits.
+// El canal alpha se multiplica por 255 en vez de por a, asi sale a + d_a * (255 - a) / 255
+inline __m128i blend_block(__m128i s, __m128i d) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i alpha_lanes = _mm_setr_epi16(0, 0, 0, 255, 0, 0, 0, 255);
+    const __m128i k255 = _mm_set1_epi16(255);
+    const __m128i k128 = _mm_set1_epi16(128);
+    __m128i half[2];
+    for (int h = 0; h < 2; h++) {
+        __m128i s16 = h == 0 ? _mm_unpacklo_epi8(s, zero) : _mm_unpackhi_epi8(s, zero);
+        __m128i d16 = h == 0 ? _mm_unpacklo_epi8(d, zero) : _mm_unpackhi_epi8(d, zero);
+        __m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s16, 0xFF), 0xFF); // Alpha en los 4 canales
+        __m128i x = _mm_add_epi16(_mm_mullo_epi16(s16, _mm_or_si128(a, alpha_lanes)),
+                                  _mm_mullo_epi16(d16, _mm_sub_epi16(k255, a)));
+        x = _mm_add_epi16(x, k128);
+        half[h] = _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+    }
+    return _mm_packus_epi16(half[0], half[1]);
+}
+
+// Bits de _mm_movemask_epi8() que corresponden a los bytes alpha de 4 pixeles RGBA
+const int alpha_mask_bits = 0x8888;
+#endif
+
+template <int DST_BPP> void blend_pixels(unsigned char* dst, const unsigned char* src, int n) {
+    int i = 0;
+#if defined(__SSE2__)
+    for (; i + 4 <= n; i += 4) {
+        __m128i s = _mm_loadu_si128((const __m128i*)(src + i * 4));
+        int opaque = _mm_movemask_epi8(_mm_cmpeq_epi8(s, _mm_set1_epi8(-1))) & alpha_mask_bits;
+        int clear = _mm_movemask_epi8(_mm_cmpeq_epi8(s, _mm_setzero_si128())) & alpha_mask_bits;
+        if (clear == alpha_mask_bits) // Los 4 transparentes: dst no cambia
+            continue;
+        unsigned char* d = dst + i * DST_BPP;
+        if (DST_BPP == 4) {
+            if (opaque == alpha_mask_bits)
+                _mm_storeu_si128((__m128i*)d, s);
+            else
+                _mm_storeu_si128((__m128i*)d, blend_block(s, _mm_loadu_si128((const __m128i*)d)));
+        } else {
+            // Los pixeles de 3 bytes se expanden a 4 para usar la misma cuenta y se vuelven a juntar
+            std::uint32_t t[4];
+            if (opaque == alpha_mask_bits) {
+                _mm_storeu_si128((__m128i*)t, s);
+            } else {
+                std::memcpy(&t[0], d, 4);
+                std::memcpy(&t[1], d + 3, 4);
+                std::memcpy(&t[2], d + 6, 4);
+                std::memcpy(&t[3], d + 8, 4);
+                t[3] >>= 8;
+                _mm_storeu_si128((__m128i*)t, blend_block(s, _mm_loadu_si128((const __m128i*)t)));
+            }
+            store_rgb_block(d, t);
+        }
+    }
+#endif
+    for (; i < n; i++)
+        blend_pixel<DST_BPP>(dst + i * DST_BPP, src + i * 4);
+}
+
+// Pesos de la luma (BT.601) en punto fijo, suman 256
+const unsigned luma_r = 77, luma_g = 150, luma_b = 29;
+
+template <int S, int D> inline void convert_pixel(unsigned char* dst, const unsigned char* src) {
+    if (D == 1) {
+        dst[0] = S == 1 ? src[0] : (std::uint8_t)((luma_b * src[0] + luma_g * src[1] + luma_r * src[2] + 128) >> 8);
+    } else {
+        for (int ch = 0; ch < 3; ch++)
+            dst[ch] = S == 1 ? src[0] : src[ch];
+        if (D == 4)
+            dst[3] = S == 4 ? src[3] : 255;
+    }
+}
+
+#if defined(__SSE2__)
+// Carga 4 pixeles de 3 bytes como 4 pixeles de 4 bytes (el cuarto byte de cada uno queda con basura).
+// No lee fuera de los 12 bytes
+inline __m128i load_rgb_block(const unsigned char* p) {
+    std::uint32_t t[4];
+    std::memcpy(&t[0], p, 4);
+    std::memcpy(&t[1], p + 3, 4);
+    std::memcpy(&t[2], p + 6, 4);
+    std::memcpy(&t[3], p + 8, 4);
+    t[3] >>= 8;
+    return _mm_loadu_si128((const __m128i*)t);
+}
+
+// Luma de 16 pixeles BGRx (4 bloques de 4), en 16 bytes
+inline __m128i luma_block(__m128i p0, __m128i p1, __m128i p2, __m128i p3) {
+    const __m128i byte = _mm_set1_epi32(0xFF);
+    // Canales separados en 16 bits: un valor por pixel (los valores son <= 255, packs no satura)
+    auto channel = [&](int shift, __m128i a, __m128i b) {
+        __m128i ca = _mm_and_si128(_mm_srli_epi32(a, shift), byte);
+        __m128i cb = _mm_and_si128(_mm_srli_epi32(b, shift), byte);
+        return _mm_packs_epi32(ca, cb);
+    };
+    __m128i y[2];
+    for (int h = 0; h < 2; h++) {
+        __m128i a = h == 0 ? p0 : p2;
+        __m128i b = h == 0 ? p1 : p3;
+        __m128i sum = _mm_add_epi16(_mm_mullo_epi16(channel(0, a, b), _mm_set1_epi16(luma_b)),
+                                    _mm_mullo_epi16(channel(8, a, b), _mm_set1_epi16(luma_g)));
+        sum = _mm_add_epi16(sum, _mm_mullo_epi16(channel(16, a, b), _mm_set1_epi16(luma_r)));
+        y[h] = _mm_srli_epi16(_mm_add_epi16(sum, _mm_set1_epi16(128)), 8); // Hasta 255 * 256 + 128, entra en 16 bits
+    }
+    return _mm_packus_epi16(y[0], y[1]);
+}
+#endif
+
+#if TGA_HAVE_DISPATCH
+// Con pshufb los pixeles de 3 bytes se expanden o se juntan con un shuffle por bloque. Los bloques leen o
+// escriben 16 bytes aunque usen 12, por eso se dejan al menos 2 pixeles de margen antes del final.
+// Retorna cuantos pixeles convirtio
+template <int S, int D>
+TGA_TARGET("ssse3")
+std::size_t convert_pixels_ssse3(unsigned char* dst, const unsigned char* src, std::size_t n) {
+    std::size_t i = 0;
+    const __m128i opaque = _mm_set1_epi32((int)0xFF000000);
+    if constexpr (S == 3 && D == 4) {
+        const __m128i expand = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+        for (; i + 6 <= n; i += 4) {
+            __m128i v = _mm_loadu_si128((const __m128i*)(src + i * 3));
+            _mm_storeu_si128((__m128i*)(dst + i * 4), _mm_or_si128(_mm_shuffle_epi8(v, expand), opaque));
+        }
+    }
+    if constexpr (S == 4 && D == 3) {
+        const __m128i pack = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+        for (; i + 6 <= n; i += 4) {
+            __m128i v = _mm_loadu_si128((const __m128i*)(src + i * 4));
+            // Se escriben 16 bytes, el bloque siguiente pisa los 4 de mas
+            _mm_storeu_si128((__m128i*)(dst + i * 3), _mm_shuffle_epi8(v, pack));
+        }
+    }
+    if constexpr (S == 1 && D == 3) {
+        const __m128i m0 = _mm_setr_epi8(0, 0, 0, 1, 1, 1, 2, 2, 2, 3, 3, 3, 4, 4, 4, 5);
+        const __m128i m1 = _mm_setr_epi8(5, 5, 6, 6, 6, 7, 7, 7, 8, 8, 8, 9, 9, 9, 10, 10);
+        const __m128i m2 = _mm_setr_epi8(10, 11, 11, 11, 12, 12, 12, 13, 13, 13, 14, 14, 14, 15, 15, 15);
+        for (; i + 16 <= n; i += 16) {
+            __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+            unsigned char* d = dst + i * 3;
+            _mm_storeu_si128((__m128i*)d, _mm_shuffle_epi8(v, m0));
+            _mm_storeu_si128((__m128i*)(d + 16), _mm_shuffle_epi8(v, m1));
+            _mm_storeu_si128((__m128i*)(d + 32), _mm_shuffle_epi8(v, m2));
+        }
+    }
+    return i;
+}
+#endif
+
+template <int S, int D> void convert_pixels(unsigned char* dst, const unsigned char* src, std::size_t n) {
+    std::size_t i = 0;
+#if TGA_HAVE_DISPATCH
+    if constexpr ((S == 3 && D == 4) || (S == 4 && D == 3) || (S == 1 && D == 3)) {
+        if (cpu_has_ssse3())
+            i = convert_pixels_ssse3<S, D>(dst, src, n);
+    }
+#endif
+#if defined(__SSE2__)
+    const __m128i opaque = _mm_set1_epi32((int)0xFF000000);
+    if constexpr (S == 1 && D == 4) {
+        for (; i + 16 <= n; i += 16) {
+            __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+            __m128i lo = _mm_unpacklo_epi8(v, v); // Cada valor dos veces
+            __m128i hi = _mm_unpackhi_epi8(v, v);
+            unsigned char* d = dst + i * 4;
+            _mm_storeu_si128((__m128i*)d, _mm_or_si128(_mm_unpacklo_epi16(lo, lo), opaque));
+            _mm_storeu_si128((__m128i*)(d + 16), _mm_or_si128(_mm_unpackhi_epi16(lo, lo), opaque));
+            _mm_storeu_si128((__m128i*)(d + 32), _mm_or_si128(_mm_unpacklo_epi16(hi, hi), opaque));
+            _mm_storeu_si128((__m128i*)(d + 48), _mm_or_si128(_mm_unpackhi_epi16(hi, hi), opaque));
+        }
+    }
+    if constexpr (D == 1 && S != 1) {
+        for (; i + 16 <= n; i += 16) {
+            const unsigned char* s = src + i * S;
+            __m128i p[4];
+            for (int k = 0; k < 4; k++)
+                p[k] = S == 4 ? _mm_loadu_si128((const __m128i*)(s + k * 16)) : load_rgb_block(s + k * 12);
+            _mm_storeu_si128((__m128i*)(dst + i), luma_block(p[0], p[1], p[2], p[3]));
+        }
+    }
+    // Sin pshufb (o lo que quedo) se expande y se junta de a 4 pixeles con load_rgb_block() y store_rgb_block()
+    if constexpr (S == 3 && D == 4) {
+        for (; i + 4 <= n; i += 4)
+            _mm_storeu_si128((__m128i*)(dst + i * 4), _mm_or_si128(load_rgb_block(src + i * 3), opaque));
+    }
+    if constexpr (S == 4 && D == 3) {
+        for (; i + 4 <= n; i += 4) {
+            std::uint32_t t[4];
+            std::memcpy(t, src + i * 4, 16);
+            store_rgb_block(dst + i * 3, t);
+        }
+    }
+#endif
+    for (; i < n; i++)
+        convert_pixel<S, D>(dst + i * D, src + i * S);
+}
+
+template <int S> void convert_from(unsigned char* dst, int dst_bytespp, const unsigned char* src, std::size_t n) {
+    switch (dst_bytespp) {
+    case 1:
+        convert_pixels<S, 1>(dst, src, n);
+        break;
+    case 3:
+        convert_pixels<S, 3>(dst, src, n);
+        break;
+    case 4:
+        convert_pixels<S, 4>(dst, src, n);
+        break;
+    }
+}
+
+#if TGA_HAVE_DISPATCH
+// Se cargan 8 indices, se extienden a 32 bits y un gather trae los 8 colores de la tabla. Retorna cuantos
+// pixeles proceso (un multiplo de 8), el resto queda para el bucle escalar
+template <int D, int I>
+TGA_TARGET("avx2")
+int lookup_pixels_avx2(unsigned char* dst, const unsigned char* src, const std::uint32_t* lut, int n) {
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i idx;
+        if (I == 1) {
+            idx = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(src + i)));
+        } else {
+            idx = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(src + i * 2)));
+        }
+        __m256i colors = _mm256_i32gather_epi32((const int*)lut, idx, 4);
+        if (D == 4) {
+            _mm256_storeu_si256((__m256i*)(dst + i * 4), colors);
+        } else {
+            std::uint32_t t[8];
+            _mm256_storeu_si256((__m256i*)t, colors);
+            store_rgb_block(dst + i * 3, t);
+            store_rgb_block(dst + i * 3 + 12, t + 4);
+        }
+    }
+    return i;
+}
+#endif
+
+template <int D, int I> void lookup_pixels(unsigned char* dst, const unsigned char* src, const std::uint32_t* lut, int n) {
+    int i = 0;
+#if TGA_HAVE_DISPATCH
+    if (cpu_has_avx2())
+        i = lookup_pixels_avx2<D, I>(dst, src, lut, n);
+#endif
+    for (; i < n; i++) {
+        unsigned index = I == 1 ? src[i] : (unsigned)(src[i * 2] | (src[i * 2 + 1] << 8));
+        std::uint32_t c = lut[index];
+        if (D == 4 || i + 1 < n)
+            std::memcpy(dst + i * D, &c, 4); // Con 3 bytes el cuarto se pisa con el pixel siguiente
+        else
+            std::memcpy(dst + i * D, &c, 3);
+    }
+}
+
+// Canal de 5 bits a 8 bits: los 3 bits bajos se llenan con los bits altos, asi 31 pasa a 255
+inline std::uint8_t expand5(unsigned v) { return (std::uint8_t)((v << 3) | (v >> 2)); }
+
+#if defined(__SSE2__)
+// 8 pixeles de 16 bits a 8 pixeles BGRA (en dos bloques de 16 bytes)
+inline void unpack_block16(__m128i v, bool alpha, __m128i& lo, __m128i& hi) {
+    const __m128i five = _mm_set1_epi16(0x1F);
+    auto expand = [](__m128i x) { return _mm_or_si128(_mm_slli_epi16(x, 3), _mm_srli_epi16(x, 2)); };
+    __m128i b = expand(_mm_and_si128(v, five));
+    __m128i g = expand(_mm_and_si128(_mm_srli_epi16(v, 5), five));
+    __m128i r = expand(_mm_and_si128(_mm_srli_epi16(v, 10), five));
+    __m128i a = alpha ? _mm_srli_epi16(_mm_srai_epi16(v, 15), 8) : _mm_set1_epi16(0xFF); // Bit 15 a 0 o 255
+    __m128i bg = _mm_or_si128(b, _mm_slli_epi16(g, 8));
+    __m128i ra = _mm_or_si128(r, _mm_slli_epi16(a, 8));
+    lo = _mm_unpacklo_epi16(bg, ra);
+    hi = _mm_unpackhi_epi16(bg, ra);
+}
+#endif
+
+template <int D> void unpack_pixels16(unsigned char* dst, const unsigned char* src, int n, bool alpha) {
+    int i = 0;
+#if defined(__SSE2__)
+    for (; i + 8 <= n; i += 8) {
+        __m128i lo, hi;
+        unpack_block16(_mm_loadu_si128((const __m128i*)(src + i * 2)), alpha, lo, hi);
+        if (D == 4) {
+            _mm_storeu_si128((__m128i*)(dst + i * 4), lo);
+            _mm_storeu_si128((__m128i*)(dst + i * 4 + 16), hi);
+        } else {
+            std::uint32_t t[8];
+            _mm_storeu_si128((__m128i*)t, lo);
+            _mm_storeu_si128((__m128i*)(t + 4), hi);
+            store_rgb_block(dst + i * 3, t);
+            store_rgb_block(dst + i * 3 + 12, t + 4);
+        }
+    }
+#endif
+    for (; i < n; i++) {
+        unsigned v = src[i * 2] | (src[i * 2 + 1] << 8);
+        unsigned char* d = dst + i * D;
+        d[0] = expand5(v & 0x1F);
+        d[1] = expand5((v >> 5) & 0x1F);
+        d[2] = expand5((v >> 10) & 0x1F);
+        if (D == 4)
+            d[3] = !alpha || (v & 0x8000) ? 255 : 0;
+    }
+}
+
+} // namespace
+
+void tga_reverse_pixels(unsigned char* row, int n, int bytespp) {
+    switch (bytespp) {
+    case 1:
+        reverse_pixels<1>(row, n);
+        break;
+    case 3:
+        reverse_pixels<3>(row, n);
+        break;
+    case 4:
+        reverse_pixels<4>(row, n);
+        break;
+    }
+}
+
+void tga_reverse_copy(unsigned char* dst, const unsigned char* src, int n, int bytespp) {
+    switch (bytespp) {
+    case 1:
+        reverse_copy<1>(dst, src, n);
+        break;
+    case 3:
+        reverse_copy<3>(dst, src, n);
+        break;
+    case 4:
+        reverse_copy<4>(dst, src, n);
+        break;
+    }
+}
+
+void tga_swap_bytes(unsigned char* a, unsigned char* b, std::size_t n) {
+    std::size_t i = 0;
+#if defined(__SSE2__)
+    for (; i + 16 <= n; i += 16) {
+        __m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+        __m128i vb = _mm_loadu_si128((const __m128i*)(b + i));
+        _mm_storeu_si128((__m128i*)(a + i), vb);
+        _mm_storeu_si128((__m128i*)(b + i), va);
+    }
+#endif
+    for (; i < n; i++) {
+        unsigned char t = a[i];
+        a[i] = b[i];
+        b[i] = t;
+    }
+}
+
+void tga_fill_pixels(unsigned char* dst, std::size_t n, const unsigned char* pixel, int bytespp) {
+    if (bytespp == 1) {
+        std::memset(dst, pixel[0], n);
+        return;
+    }
+    // 48 bytes son una cantidad entera de pixeles de 3 y de 4 bytes
+    unsigned char pattern[48];
+    for (int i = 0; i < 48; i += bytespp)
+        std::memcpy(pattern + i, pixel, bytespp);
+    std::size_t nbytes = n * bytespp;
+    std::size_t i = 0;
+#if defined(__SSE2__)
+    __m128i p0 = _mm_loadu_si128((const __m128i*)pattern);
+    __m128i p1 = _mm_loadu_si128((const __m128i*)(pattern + 16));
+    __m128i p2 = _mm_loadu_si128((const __m128i*)(pattern + 32));
+    for (; i + 48 <= nbytes; i += 48) {
+        _mm_storeu_si128((__m128i*)(dst + i), p0);
+        _mm_storeu_si128((__m128i*)(dst + i + 16), p1);
+        _mm_storeu_si128((__m128i*)(dst + i + 32), p2);
+    }
+#else
+    for (; i + 48 <= nbytes; i += 48)
+        std::memcpy(dst + i, pattern, 48);
+#endif
+    std::memcpy(dst + i, pattern, nbytes - i);
+}
+
+void tga_blend_pixels(unsigned char* dst, const unsigned char* src, int n, int dst_bytespp) {
+    switch (dst_bytespp) {
+    case 3:
+        blend_pixels<3>(dst, src, n);
+        break;
+    case 4:
+        blend_pixels<4>(dst, src, n);
+        break;
+    }
+}
+
+void tga_convert_pixels(unsigned char* dst, int dst_bytespp, const unsigned char* src, int src_bytespp,
+                        std::size_t n) {
+    if (n == 0)
+        return;
+    if (dst_bytespp == src_bytespp) {
+        std::memcpy(dst, src, n * src_bytespp);
+        return;
+    }
+    switch (src_bytespp) {
+    case 1:
+        convert_from<1>(dst, dst_bytespp, src, n);
+        break;
+    case 3:
+        convert_from<3>(dst, dst_bytespp, src, n);
+        break;
+    case 4:
+        convert_from<4>(dst, dst_bytespp, src, n);
+        break;
+    }
+}
+
+void tga_lookup_pixels(unsigned char* dst, int dst_bytespp, const unsigned char* src, int index_bytes,
+                       const std::uint32_t* lut, int n) {
+    if (dst_bytespp == 4)
+        index_bytes == 1 ? lookup_pixels<4, 1>(dst, src, lut, n) : lookup_pixels<4, 2>(dst, src, lut, n);
+    else if (dst_bytespp == 3)
+        index_bytes == 1 ? lookup_pixels<3, 1>(dst, src, lut, n) : lookup_pixels<3, 2>(dst, src, lut, n);
+}
+
+void tga_unpack_pixels16(unsigned char* dst, int dst_bytespp, const unsigned char* src, int n, bool alpha) {
+    if (dst_bytespp == 4)
+        unpack_pixels16<4>(dst, src, n, alpha);
+    else if (dst_bytespp == 3)
+        unpack_pixels16<3>(dst, src, n, alpha);
+}
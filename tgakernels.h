@@ -0,0 +1,41 @@
+#ifndef __TGAKERNELS_H__
+#define __TGAKERNELS_H__
+
+// Kernels que trabajan sobre filas de pixeles, compartidos por los archivos .cpp de la libreria
+// (no son parte de la API). Usan SSE2/SSSE3 cuando el compilador los tiene activados
+
+#include <cstddef> // Para utilizar std::size_t
+#include <cstdint> // Para utilizar std::uint32_t
+
+// Invierte el orden de los n pixeles de una fila (para voltear horizontalmente)
+void tga_reverse_pixels(unsigned char* row, int n, int bytespp);
+
+// Copia n pixeles de src a dst en orden inverso (dst[0] = src[n - 1]); src y dst no se pueden solapar
+void tga_reverse_copy(unsigned char* dst, const unsigned char* src, int n, int bytespp);
+
+// Intercambia n bytes entre a y b (para voltear verticalmente sin buffer auxiliar)
+void tga_swap_bytes(unsigned char* a, unsigned char* b, std::size_t n);
+
+// Llena n pixeles de dst con el pixel de bytespp bytes que esta en pixel
+void tga_fill_pixels(unsigned char* dst, std::size_t n, const unsigned char* pixel, int bytespp);
+
+// Compone n pixeles RGBA de src sobre dst (RGB o RGBA segun dst_bytespp) con el alpha de src:
+// color = (src * a + dst * (255 - a)) / 255 y, si dst es RGBA, alpha = a + dst_a * (255 - a) / 255
+void tga_blend_pixels(unsigned char* dst, const unsigned char* src, int n, int dst_bytespp);
+
+// Convierte n pixeles de src (src_bytespp bytes por pixel) a dst (dst_bytespp): de gris a color se repite el
+// valor en los tres canales, el alpha que falta es 255 y de color a gris se usa la luma
+// (77 * r + 150 * g + 29 * b) / 256. src y dst no se pueden solapar
+void tga_convert_pixels(unsigned char* dst, int dst_bytespp, const unsigned char* src, int src_bytespp,
+                        std::size_t n);
+
+// Expande n indices de src (de index_bytes bytes, 1 o 2) a pixeles de dst (RGB o RGBA segun dst_bytespp) con
+// la tabla lut, que tiene un color BGRA por cada indice posible (1 << 8 * index_bytes entradas)
+void tga_lookup_pixels(unsigned char* dst, int dst_bytespp, const unsigned char* src, int index_bytes,
+                       const std::uint32_t* lut, int n);
+
+// Expande n pixeles de 16 bits (A1 R5 G5 B5, como en los .tga de 15 y 16 bits) a RGB o RGBA. Cada canal de 5 bits
+// pasa a 8 repitiendo sus bits altos; el alpha es 255 si el bit 15 esta encendido o si alpha es false
+void tga_unpack_pixels16(unsigned char* dst, int dst_bytespp, const unsigned char* src, int n, bool alpha);
+
+#endif //__TGAKERNELS_H__
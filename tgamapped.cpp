@@ -0,0 +1,139 @@
+#include "tgamapped.h"
+#include "tgastats.h"
+#include <cstring>
+
+#if defined(_WIN32)
+#define TGA_HAVE_MMAP 0
+#else
+#define TGA_HAVE_MMAP 1
+#include <fcntl.h>    // open()
+#include <sys/mman.h> // mmap(), munmap(), madvise()
+#include <sys/stat.h> // fstat()
+#include <unistd.h>   // ::close()
+#endif
+
+TGAMappedImage::TGAMappedImage()
+    : m_map(nullptr), m_map_size(0), m_origin(nullptr), m_row_stride(0), m_pixel_stride(0), m_width(0), m_height(0),
+      m_bytespp(0) {}
+
+TGAMappedImage::~TGAMappedImage() { close(); }
+
+bool TGAMappedImage::is_open() const { return m_map != nullptr; }
+
+void TGAMappedImage::close() {
+#if TGA_HAVE_MMAP
+    if (m_map)
+        munmap((void*)m_map, m_map_size);
+#endif
+    m_map = nullptr;
+    m_map_size = 0;
+    m_origin = nullptr;
+    m_row_stride = 0;
+    m_pixel_stride = 0;
+    m_width = m_height = m_bytespp = 0;
+}
+
+bool TGAMappedImage::open(const char* filename) {
+    close();
+#if !TGA_HAVE_MMAP
+    tga_log() << "memory-mapped loading is not supported on this platform\n";
+    return false;
+#else
+    int fd = ::open(filename, O_RDONLY);
+    if (fd < 0) {
+        tga_log() << "can't open file " << filename << "\n";
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (std::size_t)st.st_size < sizeof(TGA_Header)) {
+        ::close(fd);
+        tga_log() << "an error occured while reading the header\n";
+        return false;
+    }
+    std::size_t size = (std::size_t)st.st_size;
+    void* map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // El mapeo sigue siendo valido despues de cerrar el descriptor
+    if (map == MAP_FAILED) {
+        tga_log() << "can't map file " << filename << "\n";
+        return false;
+    }
+    m_map = (const unsigned char*)map;
+    m_map_size = size;
+
+    TGA_Header header;
+    std::memcpy(&header, m_map, sizeof(header)); // El header no esta alineado, se copia en vez de castear
+
+    int width = header.width;
+    int height = header.height;
+    int bytespp = (std::uint8_t)header.bitsperpixel / 8;
+    if (width <= 0 || height <= 0 ||
+        (bytespp != TGAImage::GRAYSCALE && bytespp != TGAImage::RGB && bytespp != TGAImage::RGBA)) {
+        close();
+        tga_log() << "bad bpp (or width/height) value\n";
+        return false;
+    }
+    // Solo las imagenes sin comprimir pueden exponerse tal cual estan en el archivo
+    if (header.datatypecode != 2 && header.datatypecode != 3) {
+        close();
+        tga_log() << "unknown file format " << (int)header.datatypecode << " (only uncompressed files can be mapped)\n";
+        return false;
+    }
+
+    // Los pixeles empiezan despues del header, del campo de identificacion (idlength) y del colormap
+    std::size_t offset = sizeof(header) + (std::uint8_t)header.idlength;
+    if (header.colormaptype)
+        offset += (std::size_t)(unsigned short)header.colormaplength * (((std::uint8_t)header.colormapdepth + 7) / 8);
+    std::size_t row_bytes = (std::size_t)width * bytespp;
+    if (offset + row_bytes * height > size) {
+        close();
+        tga_log() << "an error occured while reading the data\n";
+        return false;
+    }
+    const unsigned char* pixels = m_map + offset;
+
+    // Bit 5 sin setear: la primera fila del archivo es la de abajo, se empieza por la ultima y se retrocede
+    if (header.imagedescriptor & 0x20) {
+        m_origin = pixels;
+        m_row_stride = (std::ptrdiff_t)row_bytes;
+    } else {
+        m_origin = pixels + row_bytes * (height - 1);
+        m_row_stride = -(std::ptrdiff_t)row_bytes;
+    }
+    // Bit 4 setado: los pixeles de cada fila van de derecha a izquierda
+    if (header.imagedescriptor & 0x10) {
+        m_origin += row_bytes - bytespp;
+        m_pixel_stride = -bytespp;
+    } else {
+        m_pixel_stride = bytespp;
+    }
+    m_width = width;
+    m_height = height;
+    m_bytespp = bytespp;
+    return true;
+#endif
+}
+
+TGAColor TGAMappedImage::get(int x, int y) const {
+    if (!m_map || x < 0 || y < 0 || x >= m_width || y >= m_height) {
+        return TGAColor();
+    }
+    return TGAColor(pixel(x, y), m_bytespp);
+}
+
+bool TGAMappedImage::copy_to(TGAImage& img) const {
+    if (!m_map)
+        return false;
+    img = TGAImage(m_width, m_height, m_bytespp, img.get_allocator(), false); // Se copian todos los pixeles
+    unsigned char* dst = img.buffer();
+    std::size_t row_bytes = (std::size_t)m_width * m_bytespp;
+    for (int y = 0; y < m_height; y++, dst += row_bytes) {
+        const unsigned char* src = row(y);
+        if (m_pixel_stride > 0) { // Fila contigua de izquierda a derecha: una sola copia
+            std::memcpy(dst, src, row_bytes);
+        } else {
+            for (int x = 0; x < m_width; x++)
+                std::memcpy(dst + x * m_bytespp, src + x * m_pixel_stride, m_bytespp);
+        }
+    }
+    return true;
+}
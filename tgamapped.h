@@ -0,0 +1,53 @@
+#ifndef __TGAMAPPED_H__
+#define __TGAMAPPED_H__
+
+#include <cstddef> // Para utilizar std::size_t y std::ptrdiff_t
+#include "tgaimage.h"
+
+// Vista de solo lectura sobre un .tga sin comprimir (datatypecode 2 y 3) mapeado en memoria con mmap.
+// No se reserva ni se copia el buffer de pixeles: los bytes se leen directamente de la pagina del archivo,
+// asi que el SO solo carga las paginas que realmente se tocan.
+// La orientacion del imagedescriptor no se corrige moviendo bytes, sino con aritmetica de origen y strides:
+// (0, 0) siempre es la esquina superior izquierda, igual que en TGAImage despues de read_tga_file().
+class TGAMappedImage {
+protected:
+	const unsigned char* m_map;    // Inicio del archivo mapeado
+	std::size_t m_map_size;        // Tamanio del mapeo en bytes
+	const unsigned char* m_origin; // Direccion del pixel (0, 0) (esquina superior izquierda)
+	std::ptrdiff_t m_row_stride;   // Bytes entre la fila y y la fila y + 1 (negativo si el archivo es bottom-up)
+	int m_pixel_stride;            // Bytes entre el pixel x y el x + 1 (negativo si el archivo es right-to-left)
+	int m_width;                   // Ancho en pixeles
+	int m_height;                  // Altura en pixeles
+	int m_bytespp;                 // Bytes por pixel
+
+public:
+	TGAMappedImage();
+	~TGAMappedImage();
+
+	// El mapeo pertenece a un solo objeto, no se puede copiar
+	TGAMappedImage(const TGAMappedImage&) = delete;
+	TGAMappedImage& operator=(const TGAMappedImage&) = delete;
+
+	bool open(const char* filename); // Mapea el archivo, retorna false si no es un .tga sin comprimir valido
+	void close();                    // Deshace el mapeo (se llama tambien en el destructor)
+	bool is_open() const;
+
+	// Lectura con verificacion de limites, igual que TGAImage::get()
+	TGAColor get(int x, int y) const;
+
+	// Acceso sin verificacion: direccion del pixel (x, y) dentro del mapeo
+	const unsigned char* pixel(int x, int y) const { return m_origin + y * m_row_stride + x * m_pixel_stride; }
+	// Direccion del pixel (0, y); los siguientes pixeles de la fila estan a get_pixel_stride() bytes
+	const unsigned char* row(int y) const { return m_origin + y * m_row_stride; }
+
+	std::ptrdiff_t get_row_stride() const { return m_row_stride; }
+	int get_pixel_stride() const { return m_pixel_stride; }
+	int get_width() const { return m_width; }
+	int get_height() const { return m_height; }
+	int get_bytespp() const { return m_bytespp; }
+
+	// Copia la vista a un TGAImage normal (con la orientacion ya corregida)
+	bool copy_to(TGAImage& img) const;
+};
+
+#endif //__TGAMAPPED_H__
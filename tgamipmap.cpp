@@ -0,0 +1,339 @@
+#include "tgamipmap.h"
+#include "tgastats.h"
+#include "tgastream.h"
+#include "tgathreads.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem> // std::filesystem::exists()
+#include <string>
+
+#if defined(__SSE2__)
+#include <emmintrin.h> // Intrinsics SSE2
+#endif
+
+namespace {
+
+// Filas del nivel 0 en cada franja de build(). Con 2^strip_levels filas cada franja se puede reducir
+// strip_levels veces sin necesitar filas de otra franja
+const int strip_levels = 4;
+const int strip_rows = 1 << strip_levels;
+
+// Alineacion del primer pixel de cada nivel dentro del bloque
+const std::size_t level_alignment = 64;
+
+double srgb_to_linear(double c) { return c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4); }
+double linear_to_srgb(double c) { return c <= 0.0031308 ? c * 12.92 : 1.055 * std::pow(c, 1.0 / 2.4) - 0.055; }
+
+// Tablas de TGA_MIP_GAMMA: de sRGB de 8 bits a lineal de 16 bits, y del promedio de valores lineales (>> 2,
+// 14 bits) de vuelta a sRGB
+struct GammaTables {
+    std::uint16_t to_linear[256];
+    std::uint8_t to_srgb[1 << 14];
+
+    GammaTables() {
+        for (int i = 0; i < 256; i++)
+            to_linear[i] = (std::uint16_t)std::lround(srgb_to_linear(i / 255.0) * 65535.0);
+        for (int i = 0; i < (1 << 14); i++) // Cada entrada corresponde al centro de su intervalo
+            to_srgb[i] = (std::uint8_t)std::lround(linear_to_srgb((i + 0.5) / (1 << 14)) * 255.0);
+    }
+};
+
+const GammaTables& gamma_tables() {
+    static GammaTables tables;
+    return tables;
+}
+
+// Un texel: promedio de ncols columnas desde x0 en las nrows filas de rows. Con GAMMA los colores se promedian
+// en espacio lineal (t son las tablas), el alpha siempre tal cual
+template <int BPP, bool GAMMA>
+inline void mip_texel(unsigned char* dst, const unsigned char* const* rows, int nrows, int x0, int ncols,
+                      const GammaTables* t) {
+    unsigned count = nrows * ncols;
+    for (int ch = 0; ch < BPP; ch++) {
+        bool linear = GAMMA && ch < 3;
+        unsigned sum = 0;
+        for (int r = 0; r < nrows; r++)
+            for (int c = 0; c < ncols; c++) {
+                unsigned char v = rows[r][(x0 + c) * BPP + ch];
+                sum += linear ? t->to_linear[v] : v;
+            }
+        dst[ch] = linear ? t->to_srgb[(sum / count) >> 2] : (std::uint8_t)((sum + count / 2) / count);
+    }
+}
+
+// Parte vectorial del filtro de caja con dos filas: los texels [0, n) con las columnas 2x y 2x + 1 (todas
+// existen). Retorna cuantos texels calculo
+template <int BPP> int box_pairs(unsigned char* dst, const unsigned char* r0, const unsigned char* r1, int n) {
+    int x = 0;
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i two = _mm_set1_epi16(2);
+    if (BPP == 4) {
+        // Suma en 16 bits de 4 pixeles de cada fila: primero las dos filas, luego cada par de pixeles vecinos
+        auto pair_sums = [&](__m128i a, __m128i c) {
+            __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(c, zero)); // Pixeles 0 y 1
+            __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(c, zero)); // Pixeles 2 y 3
+            lo = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+            hi = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+            return _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(lo, hi), two), 2);
+        };
+        for (; x + 4 <= n; x += 4) {
+            const unsigned char* a = r0 + x * 8;
+            const unsigned char* c = r1 + x * 8;
+            __m128i s0 = pair_sums(_mm_loadu_si128((const __m128i*)a), _mm_loadu_si128((const __m128i*)c));
+            __m128i s1 = pair_sums(_mm_loadu_si128((const __m128i*)(a + 16)), _mm_loadu_si128((const __m128i*)(c + 16)));
+            _mm_storeu_si128((__m128i*)(dst + x * 4), _mm_packus_epi16(s0, s1));
+        }
+    }
+    if (BPP == 1) {
+        // Los bytes pares e impares de cada bloque quedan separados en 16 bits con una mascara y un shift
+        const __m128i low = _mm_set1_epi16(0xFF);
+        auto sums = [&](__m128i a, __m128i c) {
+            __m128i even = _mm_add_epi16(_mm_and_si128(a, low), _mm_and_si128(c, low));
+            __m128i odd = _mm_add_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(c, 8));
+            return _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(even, odd), two), 2);
+        };
+        for (; x + 16 <= n; x += 16) {
+            const unsigned char* a = r0 + x * 2;
+            const unsigned char* c = r1 + x * 2;
+            __m128i s0 = sums(_mm_loadu_si128((const __m128i*)a), _mm_loadu_si128((const __m128i*)c));
+            __m128i s1 = sums(_mm_loadu_si128((const __m128i*)(a + 16)), _mm_loadu_si128((const __m128i*)(c + 16)));
+            _mm_storeu_si128((__m128i*)(dst + x), _mm_packus_epi16(s0, s1));
+        }
+    }
+#else
+    (void)dst;
+    (void)r0;
+    (void)r1;
+    (void)n;
+#endif
+    return x;
+}
+
+// Una fila de un nivel: dst (ow texels) a partir de nrows filas del nivel anterior (w pixeles). Cada texel
+// promedia las columnas 2x y 2x + 1; con ancho impar el ultimo texel junta las 3 ultimas columnas, y con ancho
+// 1 se usa la unica columna. Las filas las elige reduce() en build() con el mismo criterio
+typedef void (*MipRowFn)(unsigned char* dst, const unsigned char* const* rows, int nrows, int w, int ow);
+
+template <int BPP, bool GAMMA>
+void mip_row(unsigned char* dst, const unsigned char* const* rows, int nrows, int w, int ow) {
+    const GammaTables* t = GAMMA ? &gamma_tables() : nullptr;
+    int nx = w > 1 && (w & 1) ? ow - 1 : ow; // Texels de dos columnas
+    int x = 0;
+    if (nrows == 2 && w > 1) { // El caso comun, con la cantidad de filas y columnas fija
+        if (!GAMMA)
+            x = box_pairs<BPP>(dst, rows[0], rows[1], nx);
+        for (; x < nx; x++)
+            mip_texel<BPP, GAMMA>(dst + x * BPP, rows, 2, 2 * x, 2, t);
+    }
+    for (; x < nx; x++)
+        mip_texel<BPP, GAMMA>(dst + x * BPP, rows, nrows, 2 * x, w > 1 ? 2 : 1, t);
+    if (nx < ow)
+        mip_texel<BPP, GAMMA>(dst + nx * BPP, rows, nrows, 2 * nx, 3, t);
+}
+
+MipRowFn mip_row_function(int bytespp, TGAMipFilter filter) {
+    bool gamma = filter == TGA_MIP_GAMMA;
+    switch (bytespp) {
+    case TGAImage::GRAYSCALE:
+        return gamma ? mip_row<1, true> : mip_row<1, false>;
+    case TGAImage::RGB:
+        return gamma ? mip_row<3, true> : mip_row<3, false>;
+    case TGAImage::RGBA:
+        return gamma ? mip_row<4, true> : mip_row<4, false>;
+    }
+    return nullptr;
+}
+
+std::string level_filename(const char* prefix, int level) {
+    return std::string(prefix) + "_" + std::to_string(level) + ".tga";
+}
+
+} // namespace
+
+TGAMipChain::TGAMipChain(TGAAllocator* allocator)
+    : m_data(nullptr), m_size(0), m_bytespp(0), m_allocator(allocator ? allocator : tga_default_allocator()) {}
+
+TGAMipChain::TGAMipChain(TGAMipChain&& chain) noexcept
+    : m_data(chain.m_data), m_size(chain.m_size), m_bytespp(chain.m_bytespp), m_levels(std::move(chain.m_levels)),
+      m_allocator(chain.m_allocator) {
+    chain.m_data = nullptr;
+    chain.m_size = 0;
+    chain.m_levels.clear();
+}
+
+TGAMipChain& TGAMipChain::operator=(TGAMipChain&& chain) noexcept {
+    if (this != &chain) {
+        release();
+        m_data = chain.m_data;
+        m_size = chain.m_size;
+        m_bytespp = chain.m_bytespp;
+        m_levels = std::move(chain.m_levels);
+        m_allocator = chain.m_allocator; // El bloque se tiene que liberar con el allocator que lo reservo
+        chain.m_data = nullptr;
+        chain.m_size = 0;
+        chain.m_levels.clear();
+    }
+    return *this;
+}
+
+TGAMipChain::~TGAMipChain() { release(); }
+
+void TGAMipChain::release() {
+    if (m_data)
+        m_allocator->deallocate(m_data, m_size);
+    m_data = nullptr;
+    m_size = 0;
+    m_levels.clear();
+}
+
+void TGAMipChain::allocate(int w, int h, int bpp, int max_levels) {
+    std::vector<Level> levels;
+    std::size_t size = 0;
+    for (;;) {
+        levels.push_back({ size, w, h });
+        size += (std::size_t)w * h * bpp;
+        size = (size + level_alignment - 1) / level_alignment * level_alignment;
+        if ((w == 1 && h == 1) || (max_levels > 0 && (int)levels.size() >= max_levels))
+            break;
+        w = std::max(1, w / 2);
+        h = std::max(1, h / 2);
+    }
+    if (!m_data || size != m_size) { // Con el mismo tamanio se reutiliza el bloque
+        release();
+        m_data = m_allocator->allocate(size);
+        m_size = size;
+        tga_stats_add(TGA_STAT_ALLOCATIONS, 1);
+        tga_stats_add(TGA_STAT_ALLOCATED_BYTES, size);
+    }
+    m_levels.swap(levels);
+    m_bytespp = bpp;
+}
+
+bool TGAMipChain::build(const TGAImage& base, TGAMipFilter filter, int max_levels, int nthreads) {
+    if (!base.buffer())
+        return false;
+    int bpp = base.get_bytespp();
+    MipRowFn row_fn = mip_row_function(bpp, filter);
+    if (!row_fn) {
+        tga_log() << "bad bpp value\n";
+        return false;
+    }
+    TGAStatTimer timer(TGA_STAT_MIPMAPS, TGA_STAT_MIPMAP_NS);
+    allocate(base.get_width(), base.get_height(), bpp, max_levels);
+    int nlevels = level_count();
+
+    // Filas [j0, j1) del nivel k a partir del nivel k - 1: la fila j usa las filas 2j y 2j + 1; con altura impar
+    // la ultima fila tambien usa la ultima fila del nivel anterior, y con altura 1 se usa la unica fila
+    auto reduce = [&](int k, int j0, int j1) {
+        const Level& src = m_levels[k - 1];
+        const Level& dst = m_levels[k];
+        std::size_t src_row = (std::size_t)src.width * bpp;
+        std::size_t dst_row = (std::size_t)dst.width * bpp;
+        for (int j = j0; j < j1; j++) {
+            const unsigned char* rows[3];
+            int nrows = src.height > 1 ? 2 : 1;
+            if (src.height > 1 && (src.height & 1) && j == dst.height - 1)
+                nrows = 3;
+            for (int r = 0; r < nrows; r++)
+                rows[r] = m_data + src.offset + (2 * j + r) * src_row;
+            row_fn(m_data + dst.offset + j * dst_row, rows, nrows, src.width, dst.width);
+        }
+    };
+
+    // Cada franja copia sus filas del nivel 0 y las reduce por los primeros niveles mientras estan en cache.
+    // La fila j del nivel k solo usa las filas [j * 2^k, (j + 1) * 2^k) del nivel 0, que estan en la misma
+    // franja. La excepcion es la ultima fila de cada nivel, que con altura impar tambien usa una fila mas: esas
+    // filas (las de mas abajo) se calculan despues de las franjas, y ninguna otra fila depende de ellas
+    int height = base.get_height();
+    std::size_t row_bytes = (std::size_t)base.get_width() * bpp;
+    int nstrips = (height + strip_rows - 1) / strip_rows;
+    int strip_depth = std::min(strip_levels, nlevels - 1);
+    tga_parallel_for(nstrips, nthreads, [&](int s) {
+        int y0 = s * strip_rows;
+        int y1 = std::min(height, y0 + strip_rows);
+        std::memcpy(m_data + y0 * row_bytes, base.buffer() + y0 * row_bytes, (y1 - y0) * row_bytes);
+        for (int k = 1; k <= strip_depth; k++)
+            reduce(k, y0 >> k, std::min(m_levels[k].height - 1, (y0 + strip_rows) >> k));
+    });
+    for (int k = 1; k <= strip_depth; k++)
+        reduce(k, m_levels[k].height - 1, m_levels[k].height);
+    // Los niveles restantes ocupan menos de 1 / 4^strip_levels de la imagen
+    for (int k = strip_depth + 1; k < nlevels; k++)
+        reduce(k, 0, m_levels[k].height);
+    return true;
+}
+
+TGAImage TGAMipChain::level_image(int level) const {
+    const Level& l = m_levels[level];
+    TGAImage img(l.width, l.height, m_bytespp, m_allocator, false);
+    std::memcpy(img.buffer(), m_data + l.offset, (std::size_t)l.width * l.height * m_bytespp);
+    return img;
+}
+
+bool TGAMipChain::save(const char* prefix, bool rle) const {
+    for (int k = 0; k < level_count(); k++) {
+        TGAStreamWriter writer;
+        std::string filename = level_filename(prefix, k);
+        if (!writer.open(filename.c_str(), get_width(k), get_height(k), m_bytespp, rle) ||
+            !writer.write_rows(level_data(k), get_height(k)) || !writer.finish())
+            return false;
+    }
+    return true;
+}
+
+bool TGAMipChain::load(const char* prefix) {
+    release();
+    // Primero solo los headers, para conocer los tamanios y reservar un solo bloque
+    int width0 = 0, height0 = 0, width = 0, height = 0, bpp = 0, nlevels = 0;
+    for (int k = 0;; k++) {
+        std::string filename = level_filename(prefix, k);
+        std::error_code ec;
+        if (k > 0 && !std::filesystem::exists(filename, ec))
+            break;
+        TGAStreamReader reader;
+        if (!reader.open(filename.c_str()))
+            return false;
+        int expected_w = std::max(1, width / 2);
+        int expected_h = std::max(1, height / 2);
+        if (k == 0) {
+            width = width0 = reader.get_width();
+            height = height0 = reader.get_height();
+            bpp = reader.get_bytespp();
+        } else if (reader.get_width() != expected_w || reader.get_height() != expected_h ||
+                   reader.get_bytespp() != bpp) {
+            tga_log() << filename << " is not the next level of the mipmap chain\n";
+            return false;
+        } else {
+            width = expected_w;
+            height = expected_h;
+        }
+        nlevels++;
+        if (width == 1 && height == 1)
+            break;
+    }
+
+    allocate(width0, height0, bpp, nlevels);
+    for (int k = 0; k < nlevels; k++) {
+        std::string filename = level_filename(prefix, k);
+        TGAStreamReader reader;
+        if (!reader.open(filename.c_str())) {
+            release();
+            return false;
+        }
+        std::size_t row_bytes = (std::size_t)get_width(k) * bpp;
+        for (int i = 0; i < get_height(k); i++) {
+            int y;
+            const unsigned char* row = reader.next_row(&y);
+            if (!row) {
+                tga_log() << "can't read " << filename << "\n";
+                release();
+                return false;
+            }
+            std::memcpy(level_data(k) + y * row_bytes, row, row_bytes);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,81 @@
+#ifndef __TGAMIPMAP_H__
+#define __TGAMIPMAP_H__
+
+#include <cstddef> // Para utilizar std::size_t
+#include <vector>
+#include "tgaimage.h"
+#include "tgaview.h"
+
+// Filtros para reducir cada nivel a la mitad
+enum TGAMipFilter {
+	TGA_MIP_BOX,  // Promedio de 2x2 pixeles sobre los bytes tal cual
+	TGA_MIP_GAMMA // Promedio de 2x2 en espacio lineal: los colores se tratan como sRGB, el alpha se promedia tal cual
+};
+
+// Cadena de mipmaps de una textura: el nivel 0 es la imagen original y cada nivel mide la mitad del anterior
+// (redondeando hacia abajo, minimo 1) hasta llegar a 1x1. Cada texel promedia 2x2 pixeles del nivel anterior;
+// con un lado impar el ultimo texel de ese lado junta los 3 ultimos pixeles, asi no se pierde ninguno. Todos
+// los niveles estan en un solo bloque de memoria, uno detras de otro, y cada nivel empieza alineado a 64 bytes.
+//
+// build() recorre la imagen original una sola vez: la imagen se divide en franjas de pocas filas y cada franja
+// se reduce por todos los niveles seguidos mientras todavia esta en cache (las franjas se reparten entre los
+// hilos). Los niveles que quedan mas chicos que una franja se calculan al final a partir del ultimo nivel
+class TGAMipChain {
+public:
+	struct Level {
+		std::size_t offset; // Posicion del primer pixel dentro del bloque
+		int width;
+		int height;
+	};
+
+protected:
+	unsigned char* m_data;   // Todos los niveles, del 0 al ultimo
+	std::size_t m_size;      // Bytes de m_data
+	int m_bytespp;
+	std::vector<Level> m_levels;
+	TGAAllocator* m_allocator;
+
+	// Calcula los niveles de w x h pixeles (hasta max_levels, <= 0: todos) y reserva el bloque
+	void allocate(int w, int h, int bpp, int max_levels);
+	void release();
+
+public:
+	// allocator == nullptr usa tga_default_allocator()
+	explicit TGAMipChain(TGAAllocator* allocator = nullptr);
+	TGAMipChain(TGAMipChain&& chain) noexcept;
+	TGAMipChain& operator=(TGAMipChain&& chain) noexcept;
+	TGAMipChain(const TGAMipChain&) = delete;
+	TGAMipChain& operator=(const TGAMipChain&) = delete;
+	~TGAMipChain();
+
+	// Arma la cadena a partir de base (se copia como nivel 0). max_levels: cantidad de niveles, incluido el 0
+	// (<= 0: hasta 1x1). Las franjas se reparten en nthreads hilos (<= 0: todos los nucleos)
+	bool build(const TGAImage& base, TGAMipFilter filter = TGA_MIP_BOX, int max_levels = 0, int nthreads = 1);
+
+	// Guarda cada nivel en un .tga: prefix_0.tga, prefix_1.tga, ... (el origen es arriba a la izquierda)
+	bool save(const char* prefix, bool rle = true) const;
+	// Carga los niveles guardados con save(): lee prefix_0.tga, prefix_1.tga, ... hasta que falta un archivo.
+	// Cada nivel tiene que medir la mitad del anterior y tener los mismos bytes por pixel
+	bool load(const char* prefix);
+
+	int level_count() const { return (int)m_levels.size(); }
+	int get_width(int level) const { return m_levels[level].width; }
+	int get_height(int level) const { return m_levels[level].height; }
+	int get_bytespp() const { return m_bytespp; }
+	std::size_t get_size() const { return m_size; } // Bytes de todos los niveles juntos
+
+	// Pixeles del nivel (filas seguidas, de arriba hacia abajo)
+	unsigned char* level_data(int level) { return m_data + m_levels[level].offset; }
+	const unsigned char* level_data(int level) const { return m_data + m_levels[level].offset; }
+	// Copia del nivel como imagen aparte, con el mismo allocator que la cadena
+	TGAImage level_image(int level) const;
+	// Vista tipada sobre el nivel, vacia si la cadena no tiene el formato F
+	template <TGAImage::Format F> TGAImageView<F> view(int level) {
+		if (F != m_bytespp)
+			return TGAImageView<F>();
+		const Level& l = m_levels[level];
+		return TGAImageView<F>((TGAPixel<F>*)(m_data + l.offset), l.width, l.height, l.width);
+	}
+};
+
+#endif //__TGAMIPMAP_H__
@@ -0,0 +1,234 @@
+#include "tgaraster.h"
+#include "tgakernels.h"
+#include "tgathreads.h"
+#include "tgaview.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace {
+
+// Los vertices se redondean a 1/16 de pixel
+const int subpixel_bits = 4;
+const int subpixel = 1 << subpixel_bits;
+
+// Coordenada maxima (en pixeles) de un vertice, asi las edge functions entran en 64 bits sin desbordarse
+const float max_coord = (float)(1 << 20);
+
+} // namespace
+
+// Datos de un triangulo que se calculan una sola vez antes de rasterizar
+struct TGARasterizer::Setup {
+    // Edge function i (opuesta al vertice i): w_i = a[i] * px + b[i] * py + c[i], con px y py en 1/16 de pixel.
+    // Es positiva dentro del triangulo
+    std::int64_t a[3], b[3], c[3];
+    int bias[3];                 // 1 si los pixeles justo sobre ese borde son del triangulo, 0 si son del vecino
+    float inv_area;              // Para pasar de w_i a coordenadas baricentricas
+    float z0, dz1, dz2;          // z = z0 + l1 * dz1 + l2 * dz2
+    float c0[4], dc1[4], dc2[4]; // Lo mismo para cada byte del color
+    bool flat;                   // Los tres vertices tienen el mismo color
+    int x0, y0, x1, y1;          // Bounding box en pixeles, [x0, x1) x [y0, y1), ya recortado a la imagen
+};
+
+namespace {
+
+// Prepara el triangulo de los vertices v; false si no tiene area o queda fuera de la imagen
+template <class Setup>
+bool setup_triangle(const TGAVertex* v, int width, int height, int bpp, Setup& s) {
+    std::int64_t x[3], y[3];
+    for (int i = 0; i < 3; i++) {
+        if (!(std::fabs(v[i].x) < max_coord && std::fabs(v[i].y) < max_coord)) // Tambien descarta NaN
+            return false;
+        x[i] = std::lround(v[i].x * subpixel);
+        y[i] = std::lround(v[i].y * subpixel);
+    }
+    for (int i = 0; i < 3; i++) {
+        int j = (i + 1) % 3;
+        int k = (i + 2) % 3;
+        s.a[i] = y[j] - y[k];
+        s.b[i] = x[k] - x[j];
+        s.c[i] = x[j] * y[k] - y[j] * x[k];
+    }
+    std::int64_t area = s.a[0] * x[0] + s.b[0] * y[0] + s.c[0]; // El doble del area, con signo
+    if (area == 0)
+        return false;
+    if (area < 0) { // Se aceptan las dos orientaciones
+        area = -area;
+        for (int i = 0; i < 3; i++) {
+            s.a[i] = -s.a[i];
+            s.b[i] = -s.b[i];
+            s.c[i] = -s.c[i];
+        }
+    }
+    // Un borde compartido aparece en el otro triangulo con a y b cambiados de signo, asi que exactamente uno
+    // de los dos se queda con los pixeles que caen justo sobre el
+    for (int i = 0; i < 3; i++)
+        s.bias[i] = (s.a[i] > 0 || (s.a[i] == 0 && s.b[i] > 0)) ? 1 : 0;
+    s.inv_area = 1.0f / (float)area;
+
+    std::int64_t minx = std::min({ x[0], x[1], x[2] }), maxx = std::max({ x[0], x[1], x[2] });
+    std::int64_t miny = std::min({ y[0], y[1], y[2] }), maxy = std::max({ y[0], y[1], y[2] });
+    // Pixeles cuyo centro (p * 16 + 8) puede caer dentro
+    s.x0 = (int)std::max<std::int64_t>(0, (minx - subpixel / 2 + subpixel - 1) >> subpixel_bits);
+    s.y0 = (int)std::max<std::int64_t>(0, (miny - subpixel / 2 + subpixel - 1) >> subpixel_bits);
+    s.x1 = (int)std::min<std::int64_t>(width, ((maxx - subpixel / 2) >> subpixel_bits) + 1);
+    s.y1 = (int)std::min<std::int64_t>(height, ((maxy - subpixel / 2) >> subpixel_bits) + 1);
+    if (s.x0 >= s.x1 || s.y0 >= s.y1)
+        return false;
+
+    s.z0 = v[0].z;
+    s.dz1 = v[1].z - v[0].z;
+    s.dz2 = v[2].z - v[0].z;
+    std::uint8_t c[3][4]; // Colores en el formato de la imagen, convertidos igual que en TGAImage::set()
+    for (int i = 0; i < 3; i++) {
+        int cbpp = v[i].color.bytespp;
+        if (cbpp == bpp || (cbpp != TGAImage::GRAYSCALE && cbpp != TGAImage::RGB && cbpp != TGAImage::RGBA))
+            std::memcpy(c[i], v[i].color.raw, bpp);
+        else
+            tga_convert_pixels(c[i], bpp, v[i].color.raw, cbpp, 1);
+    }
+    s.flat = true;
+    for (int ch = 0; ch < bpp; ch++) {
+        s.c0[ch] = c[0][ch];
+        s.dc1[ch] = (float)c[1][ch] - c[0][ch];
+        s.dc2[ch] = (float)c[2][ch] - c[0][ch];
+        s.flat = s.flat && s.dc1[ch] == 0.0f && s.dc2[ch] == 0.0f;
+    }
+    return true;
+}
+
+// Rasteriza en el tile [tx0, tx1) x [ty0, ty1) los triangulos de bins (en orden). depth es el z-buffer del tile
+template <TGAImage::Format F, class Setup>
+void render_tile(const TGAImageView<F>& view, const std::vector<Setup>& setups,
+                 const std::vector<std::vector<std::vector<int>>>& bins, int tile, int tx0, int ty0, int tx1, int ty1,
+                 std::vector<float>& depth) {
+    typedef typename TGAImageView<F>::Pixel Pixel;
+    const int bpp = F;
+    int tw = tx1 - tx0;
+    depth.assign((std::size_t)tw * (ty1 - ty0), -std::numeric_limits<float>::infinity());
+    for (const std::vector<std::vector<int>>& chunk : bins) {
+        for (int t : chunk[tile]) {
+            const Setup& s = setups[t];
+            int x0 = std::max(s.x0, tx0), x1 = std::min(s.x1, tx1);
+            int y0 = std::max(s.y0, ty0), y1 = std::min(s.y1, ty1);
+            std::int64_t px0 = (std::int64_t)x0 * subpixel + subpixel / 2;
+            std::int64_t step[3] = { s.a[0] * subpixel, s.a[1] * subpixel, s.a[2] * subpixel }; // Un pixel en x
+            Pixel flat_pixel = {};
+            if (s.flat) {
+                std::uint8_t raw[4];
+                for (int ch = 0; ch < bpp; ch++)
+                    raw[ch] = (std::uint8_t)s.c0[ch];
+                std::memcpy(&flat_pixel, raw, sizeof(Pixel));
+            }
+            for (int y = y0; y < y1; y++) {
+                std::int64_t py = (std::int64_t)y * subpixel + subpixel / 2;
+                std::int64_t w[3];
+                for (int i = 0; i < 3; i++)
+                    w[i] = s.a[i] * px0 + s.b[i] * py + s.c[i] + s.bias[i] - 1; // Con bias, dentro es w >= 0
+                Pixel* row = view.row(y);
+                float* zrow = depth.data() + (std::size_t)(y - ty0) * tw;
+                for (int x = x0; x < x1; x++) {
+                    if ((w[0] | w[1] | w[2]) >= 0) { // Los tres >= 0: el bit de signo de ninguno esta encendido
+                        float l1 = (float)(w[1] + 1 - s.bias[1]) * s.inv_area;
+                        float l2 = (float)(w[2] + 1 - s.bias[2]) * s.inv_area;
+                        float z = s.z0 + l1 * s.dz1 + l2 * s.dz2;
+                        if (z > zrow[x - tx0]) {
+                            zrow[x - tx0] = z;
+                            if (s.flat) {
+                                row[x] = flat_pixel;
+                            } else {
+                                std::uint8_t raw[4];
+                                for (int ch = 0; ch < bpp; ch++) {
+                                    float c = s.c0[ch] + l1 * s.dc1[ch] + l2 * s.dc2[ch] + 0.5f;
+                                    raw[ch] = (std::uint8_t)std::min(255.0f, std::max(0.0f, c));
+                                }
+                                std::memcpy(&row[x], raw, sizeof(Pixel));
+                            }
+                        }
+                    }
+                    for (int i = 0; i < 3; i++)
+                        w[i] += step[i];
+                }
+            }
+        }
+    }
+}
+
+template <TGAImage::Format F, class Setup>
+void render_image(TGAImage& target, const std::vector<TGAVertex>& vertices, int nthreads, int tile_size) {
+    TGAImageView<F> view(target);
+    int width = view.get_width();
+    int height = view.get_height();
+    int ntris = (int)(vertices.size() / 3);
+    int tiles_x = (width + tile_size - 1) / tile_size;
+    int tiles_y = (height + tile_size - 1) / tile_size;
+    int ntiles = tiles_x * tiles_y;
+
+    // Preparacion y binning en paralelo: cada trozo de triangulos arma sus propias listas por tile, y al
+    // rasterizar se recorren los trozos en orden, asi se respeta el orden en que se agregaron los triangulos
+    nthreads = tga_resolve_threads(nthreads);
+    int nchunks = std::max(1, std::min(nthreads, ntris / 256));
+    std::vector<Setup> setups(ntris);
+    std::vector<std::vector<std::vector<int>>> bins(nchunks, std::vector<std::vector<int>>(ntiles));
+    tga_parallel_for(nchunks, nthreads, [&](int k) {
+        int t1 = (int)((std::int64_t)ntris * (k + 1) / nchunks);
+        for (int t = (int)((std::int64_t)ntris * k / nchunks); t < t1; t++) {
+            Setup& s = setups[t];
+            if (!setup_triangle(&vertices[(std::size_t)t * 3], width, height, F, s))
+                continue;
+            for (int ty = s.y0 / tile_size; ty <= (s.y1 - 1) / tile_size; ty++)
+                for (int tx = s.x0 / tile_size; tx <= (s.x1 - 1) / tile_size; tx++)
+                    bins[k][ty * tiles_x + tx].push_back(t);
+        }
+    });
+
+    tga_parallel_for(ntiles, nthreads, [&](int tile) {
+        thread_local std::vector<float> depth; // Un z-buffer por hilo, se reutiliza entre tiles
+        int tx0 = (tile % tiles_x) * tile_size;
+        int ty0 = (tile / tiles_x) * tile_size;
+        render_tile<F>(view, setups, bins, tile, tx0, ty0, std::min(width, tx0 + tile_size),
+                       std::min(height, ty0 + tile_size), depth);
+    });
+
+    // Las filas de los tiles con triangulos se escribieron a traves de la vista, ver TGAImage::track_changes()
+    for (int tile = 0; tile < ntiles; tile++) {
+        bool touched = false;
+        for (int k = 0; k < nchunks && !touched; k++)
+            touched = !bins[k][tile].empty();
+        if (touched) {
+            int ty0 = (tile / tiles_x) * tile_size;
+            target.mark_dirty(ty0, std::min(height, ty0 + tile_size));
+        }
+    }
+}
+
+} // namespace
+
+TGARasterizer::TGARasterizer(int nthreads, int tile_size)
+    : m_nthreads(nthreads), m_tile_size(std::max(8, tile_size)) {}
+
+void TGARasterizer::add_triangle(const TGAVertex& a, const TGAVertex& b, const TGAVertex& c) {
+    m_vertices.push_back(a);
+    m_vertices.push_back(b);
+    m_vertices.push_back(c);
+}
+
+void TGARasterizer::clear() { m_vertices.clear(); }
+
+bool TGARasterizer::render(TGAImage& target) {
+    if (!target.buffer())
+        return false;
+    switch (target.get_bytespp()) {
+    case TGAImage::GRAYSCALE:
+        render_image<TGAImage::GRAYSCALE, Setup>(target, m_vertices, m_nthreads, m_tile_size);
+        return true;
+    case TGAImage::RGB:
+        render_image<TGAImage::RGB, Setup>(target, m_vertices, m_nthreads, m_tile_size);
+        return true;
+    case TGAImage::RGBA:
+        render_image<TGAImage::RGBA, Setup>(target, m_vertices, m_nthreads, m_tile_size);
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,43 @@
+#ifndef __TGARASTER_H__
+#define __TGARASTER_H__
+
+#include <cstdint>
+#include <vector>
+#include "tgaimage.h"
+
+// Vertice ya proyectado: x, y en pixeles de la imagen (y hacia abajo, como en TGAImage) y z la profundidad.
+// Gana el pixel con mayor z (la misma convencion que el z-buffer de tinyrenderer)
+struct TGAVertex {
+	float x, y, z;
+	TGAColor color; // Se interpola entre los tres vertices
+};
+
+// Rasterizador por tiles: la imagen se divide en tiles de tile_size x tile_size pixeles, cada triangulo se
+// anota en los tiles que toca su bounding box y los hilos se reparten los tiles. Como dos hilos nunca tocan el
+// mismo tile no hacen falta locks: cada hilo tiene su propio z-buffer del tamanio de un tile y escribe las
+// filas directamente en los pixeles de la imagen.
+//
+// Los vertices se redondean a 1/16 de pixel y las edge functions se calculan con enteros, asi los pixeles del
+// borde compartido por dos triangulos se pintan una sola vez. Dentro de cada tile los triangulos se dibujan en
+// el orden en que se agregaron, el resultado no depende de la cantidad de hilos
+class TGARasterizer {
+protected:
+	struct Setup;
+	std::vector<TGAVertex> m_vertices; // 3 por triangulo
+	int m_nthreads;
+	int m_tile_size;
+
+public:
+	// nthreads <= 0: todos los nucleos
+	explicit TGARasterizer(int nthreads = 0, int tile_size = 64);
+
+	void add_triangle(const TGAVertex& a, const TGAVertex& b, const TGAVertex& c);
+	std::size_t triangle_count() const { return m_vertices.size() / 3; }
+	void clear(); // Descarta los triangulos agregados
+
+	// Dibuja todos los triangulos agregados sobre target (la imagen no se limpia antes). Los triangulos se
+	// recortan a la imagen y el z-buffer empieza vacio en cada llamada
+	bool render(TGAImage& target);
+};
+
+#endif //__TGARASTER_H__
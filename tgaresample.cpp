@@ -0,0 +1,275 @@
+#include "tgaresample.h"
+#include "tgastats.h"
+#include "tgathreads.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h> // Intrinsics SSE2
+#endif
+
+namespace {
+
+// Los pesos se guardan en punto fijo: 1.0 == 1 << weight_bits
+const int weight_bits = 14;
+const int weight_round = 1 << (weight_bits - 1);
+
+// Filas que procesa cada tarea cuando se reparte el trabajo entre hilos
+const int resample_band_rows = 32;
+
+const double pi = 3.14159265358979323846;
+
+// Radio del filtro en pixeles de la imagen original (cuando no se reduce)
+double filter_support(TGAFilter filter) {
+    switch (filter) {
+    case TGA_FILTER_BOX:
+        return 0.5;
+    case TGA_FILTER_BILINEAR:
+        return 1.0;
+    case TGA_FILTER_BICUBIC:
+        return 2.0;
+    case TGA_FILTER_LANCZOS3:
+        return 3.0;
+    }
+    return 1.0;
+}
+
+double sinc(double x) {
+    if (x == 0.0)
+        return 1.0;
+    x *= pi;
+    return std::sin(x) / x;
+}
+
+double filter_value(TGAFilter filter, double x) {
+    x = std::fabs(x);
+    switch (filter) {
+    case TGA_FILTER_BOX:
+        return x < 0.5 ? 1.0 : 0.0;
+    case TGA_FILTER_BILINEAR:
+        return x < 1.0 ? 1.0 - x : 0.0;
+    case TGA_FILTER_BICUBIC: { // Catmull-Rom, a = -0.5
+        const double a = -0.5;
+        if (x < 1.0)
+            return ((a + 2.0) * x - (a + 3.0)) * x * x + 1.0;
+        if (x < 2.0)
+            return (((x - 5.0) * x + 8.0) * x - 4.0) * a;
+        return 0.0;
+    }
+    case TGA_FILTER_LANCZOS3:
+        return x < 3.0 ? sinc(x) * sinc(x / 3.0) : 0.0;
+    }
+    return 0.0;
+}
+
+// Tabla de pesos de un eje: el pixel nuevo i es la suma de weights[i * taps + k] * original[start[i] + k]
+struct WeightTable {
+    int taps;
+    std::vector<int> start;
+    std::vector<std::int16_t> weights;
+};
+
+WeightTable make_weight_table(int in, int out, TGAFilter filter) {
+    double scale = (double)in / out;
+    double fscale = std::max(1.0, scale); // Al reducir el filtro se ensancha para cubrir todos los pixeles
+    double support = filter_support(filter) * fscale;
+
+    WeightTable t;
+    t.taps = std::min(in, (int)std::ceil(2.0 * support) + 1);
+    t.start.resize(out);
+    t.weights.assign((std::size_t)out * t.taps, 0);
+    std::vector<double> w(t.taps);
+    for (int i = 0; i < out; i++) {
+        double center = (i + 0.5) * scale; // El pixel j cubre [j, j + 1), su centro esta en j + 0.5
+        int lo = std::max(0, (int)std::floor(center - support));
+        int hi = std::min(in, (int)std::ceil(center + support));
+        hi = std::min(hi, lo + t.taps);
+        // En los bordes el filtro se corta y se vuelve a normalizar
+        double sum = 0.0;
+        for (int j = lo; j < hi; j++) {
+            w[j - lo] = filter_value(filter, (j + 0.5 - center) / fscale);
+            sum += w[j - lo];
+        }
+        // start + taps no puede pasarse del final, los pesos se corren dentro de la ventana
+        int start = std::min(lo, in - t.taps);
+        std::int16_t* dst = &t.weights[(std::size_t)i * t.taps + (lo - start)];
+        int total = 0;
+        int biggest = 0;
+        for (int j = 0; j < hi - lo; j++) {
+            double v = sum != 0.0 ? w[j] / sum : (j == 0 ? 1.0 : 0.0);
+            dst[j] = (std::int16_t)std::lround(v * (1 << weight_bits));
+            total += dst[j];
+            if (dst[j] > dst[biggest])
+                biggest = j;
+        }
+        dst[biggest] += (1 << weight_bits) - total; // La suma tiene que ser exactamente 1.0
+        t.start[i] = start;
+    }
+    return t;
+}
+
+#if defined(__SSE2__)
+// Carga los 4 bytes de un pixel RGBA en la parte baja de un registro
+inline __m128i load_pixel(const unsigned char* p) {
+    int v;
+    std::memcpy(&v, p, 4);
+    return _mm_cvtsi32_si128(v);
+}
+
+// Dos pesos de 16 bits repetidos en cada grupo de 32 bits, para _mm_madd_epi16
+inline __m128i weight_pair(std::int16_t w0, std::int16_t w1) {
+    return _mm_set1_epi32((int)(((std::uint32_t)(std::uint16_t)w1 << 16) | (std::uint16_t)w0));
+}
+#endif
+
+inline unsigned char clamp_pixel(int acc) {
+    acc >>= weight_bits;
+    return (unsigned char)(acc < 0 ? 0 : (acc > 255 ? 255 : acc));
+}
+
+// Pasada horizontal de una fila
+template <int BPP> void resample_row(const unsigned char* src, unsigned char* dst, int out_w, const WeightTable& t) {
+    for (int x = 0; x < out_w; x++, dst += BPP) {
+        const unsigned char* p = src + t.start[x] * BPP;
+        const std::int16_t* w = &t.weights[(std::size_t)x * t.taps];
+        int k = 0;
+#if defined(__SSE2__)
+        if constexpr (BPP == 4) { // Dos pixeles por iteracion: [b0 b1 g0 g1 r0 r1 a0 a1] * [w0 w1 ...]
+            const __m128i zero = _mm_setzero_si128();
+            __m128i acc = _mm_set1_epi32(weight_round);
+            for (; k + 1 < t.taps; k += 2) {
+                __m128i p0 = _mm_unpacklo_epi8(load_pixel(p + k * 4), zero);
+                __m128i p1 = _mm_unpacklo_epi8(load_pixel(p + k * 4 + 4), zero);
+                __m128i wk = weight_pair(w[k], w[k + 1]);
+                acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_unpacklo_epi16(p0, p1), wk));
+            }
+            if (k < t.taps) {
+                __m128i p0 = _mm_unpacklo_epi8(load_pixel(p + k * 4), zero);
+                __m128i wk = weight_pair(w[k], 0);
+                acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_unpacklo_epi16(p0, zero), wk));
+            }
+            acc = _mm_srai_epi32(acc, weight_bits);
+            acc = _mm_packus_epi16(_mm_packs_epi32(acc, acc), zero);
+            int v = _mm_cvtsi128_si32(acc);
+            std::memcpy(dst, &v, 4);
+            continue;
+        }
+#endif
+        int acc[BPP];
+        for (int c = 0; c < BPP; c++)
+            acc[c] = weight_round;
+        for (; k < t.taps; k++)
+            for (int c = 0; c < BPP; c++)
+                acc[c] += w[k] * p[k * BPP + c];
+        for (int c = 0; c < BPP; c++)
+            dst[c] = clamp_pixel(acc[c]);
+    }
+}
+
+// Pasada vertical de una fila nueva: dst[x] = suma de w[k] * rows[k][x], para los n bytes de la fila
+void resample_column(const unsigned char* const* rows, const std::int16_t* w, int taps, unsigned char* dst,
+                     std::size_t n) {
+    std::size_t x = 0;
+#if defined(__SSE2__)
+    // 8 bytes por iteracion, dos filas a la vez con _mm_madd_epi16
+    const __m128i zero = _mm_setzero_si128();
+    for (; x + 8 <= n; x += 8) {
+        __m128i lo = _mm_set1_epi32(weight_round);
+        __m128i hi = lo;
+        int k = 0;
+        for (; k + 1 < taps; k += 2) {
+            __m128i a = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(rows[k] + x)), zero);
+            __m128i b = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(rows[k + 1] + x)), zero);
+            __m128i wk = weight_pair(w[k], w[k + 1]);
+            lo = _mm_add_epi32(lo, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), wk));
+            hi = _mm_add_epi32(hi, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), wk));
+        }
+        if (k < taps) {
+            __m128i a = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(rows[k] + x)), zero);
+            __m128i wk = weight_pair(w[k], 0);
+            lo = _mm_add_epi32(lo, _mm_madd_epi16(_mm_unpacklo_epi16(a, zero), wk));
+            hi = _mm_add_epi32(hi, _mm_madd_epi16(_mm_unpackhi_epi16(a, zero), wk));
+        }
+        lo = _mm_srai_epi32(lo, weight_bits);
+        hi = _mm_srai_epi32(hi, weight_bits);
+        _mm_storel_epi64((__m128i*)(dst + x), _mm_packus_epi16(_mm_packs_epi32(lo, hi), zero));
+    }
+#endif
+    for (; x < n; x++) {
+        int acc = weight_round;
+        for (int k = 0; k < taps; k++)
+            acc += w[k] * rows[k][x];
+        dst[x] = clamp_pixel(acc);
+    }
+}
+
+template <int BPP>
+void resample(const unsigned char* src, int in_w, int in_h, unsigned char* dst, int out_w, int out_h,
+              TGAFilter filter, int nthreads) {
+    std::size_t in_row = (std::size_t)in_w * BPP;
+    std::size_t out_row = (std::size_t)out_w * BPP;
+
+    // Pasada horizontal: in_h filas de out_w pixeles (si el ancho no cambia se usa src directamente)
+    std::vector<unsigned char> tmp;
+    const unsigned char* rows = src;
+    if (out_w != in_w) {
+        WeightTable tx = make_weight_table(in_w, out_w, filter);
+        tmp.resize(in_h * out_row);
+        int nbands = (in_h + resample_band_rows - 1) / resample_band_rows;
+        tga_parallel_for(nbands, nthreads, [&](int b) {
+            int y1 = std::min(in_h, (b + 1) * resample_band_rows);
+            for (int y = b * resample_band_rows; y < y1; y++)
+                resample_row<BPP>(src + y * in_row, tmp.data() + y * out_row, out_w, tx);
+        });
+        rows = tmp.data();
+    }
+
+    // Pasada vertical
+    if (out_h == in_h) {
+        std::copy(rows, rows + in_h * out_row, dst);
+        return;
+    }
+    WeightTable ty = make_weight_table(in_h, out_h, filter);
+    int nbands = (out_h + resample_band_rows - 1) / resample_band_rows;
+    tga_parallel_for(nbands, nthreads, [&](int b) {
+        std::vector<const unsigned char*> taps(ty.taps);
+        int y1 = std::min(out_h, (b + 1) * resample_band_rows);
+        for (int y = b * resample_band_rows; y < y1; y++) {
+            for (int k = 0; k < ty.taps; k++)
+                taps[k] = rows + (ty.start[y] + k) * out_row;
+            resample_column(taps.data(), &ty.weights[(std::size_t)y * ty.taps], ty.taps, dst + y * out_row, out_row);
+        }
+    });
+}
+
+} // namespace
+
+bool tga_resample(const TGAImage& src, TGAImage& dst, int w, int h, TGAFilter filter, int nthreads) {
+    if (w <= 0 || h <= 0 || !src.buffer()) // Controla si la altura o el ancho es menor a 0, o si src esta vacia
+        return false;
+    int bpp = src.get_bytespp();
+    if (bpp != TGAImage::GRAYSCALE && bpp != TGAImage::RGB && bpp != TGAImage::RGBA) {
+        tga_log() << "bad bpp value\n";
+        return false;
+    }
+    TGAStatTimer timer(TGA_STAT_SCALES, TGA_STAT_SCALE_NS);
+    // Se redimensiona en una imagen aparte (src puede ser dst) con el allocator de dst, que luego se queda con
+    // el buffer. Se sobreescriben todos los pixeles, no hace falta llenar con 0
+    TGAImage out(w, h, bpp, dst.get_allocator(), false);
+    switch (bpp) {
+    case TGAImage::GRAYSCALE:
+        resample<1>(src.buffer(), src.get_width(), src.get_height(), out.buffer(), w, h, filter, nthreads);
+        break;
+    case TGAImage::RGB:
+        resample<3>(src.buffer(), src.get_width(), src.get_height(), out.buffer(), w, h, filter, nthreads);
+        break;
+    case TGAImage::RGBA:
+        resample<4>(src.buffer(), src.get_width(), src.get_height(), out.buffer(), w, h, filter, nthreads);
+        break;
+    }
+    dst = std::move(out);
+    return true;
+}
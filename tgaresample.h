@@ -0,0 +1,21 @@
+#ifndef __TGARESAMPLE_H__
+#define __TGARESAMPLE_H__
+
+#include "tgaimage.h"
+
+// Filtros disponibles para tga_resample(), de mas rapido a mas nitido
+enum TGAFilter {
+	TGA_FILTER_BOX,      // Promedio de los pixeles que cubre cada pixel nuevo (bueno para reducir a la mitad, etc.)
+	TGA_FILTER_BILINEAR, // Triangulo de radio 1
+	TGA_FILTER_BICUBIC,  // Catmull-Rom (a = -0.5), radio 2
+	TGA_FILTER_LANCZOS3  // Lanczos de radio 3, el mas nitido
+};
+
+// Redimensiona src a w x h pixeles y guarda el resultado en dst (dst puede ser cualquier imagen, no src).
+// Es separable: primero se filtra cada fila y despues cada columna, con tablas de pesos precalculadas para
+// cada eje. Al reducir el filtro se ensancha en proporcion, asi cada pixel nuevo promedia todos los pixeles
+// que cubre y no hay aliasing. Las filas se reparten en nthreads hilos (<= 0: todos los nucleos)
+bool tga_resample(const TGAImage& src, TGAImage& dst, int w, int h, TGAFilter filter = TGA_FILTER_BICUBIC,
+                  int nthreads = 1);
+
+#endif //__TGARESAMPLE_H__
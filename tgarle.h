@@ -0,0 +1,307 @@
+#ifndef __TGARLE_H__
+#define __TGARLE_H__
+
+// Codificador y decodificador RLE compartido por los archivos .cpp de la libreria (no es parte de la API)
+
+#include "tgastats.h" // tga_log() y los contadores
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h> // Intrinsics SSE2
+#endif
+
+// Tamanio de los bloques que se leen del archivo de una sola vez
+const std::size_t rle_block_size = 1 << 16;
+
+// Tamanio a partir del cual el buffer de salida se vuelca al archivo
+const std::size_t rle_flush_size = 1 << 20;
+
+// Lector por bloques para los datos RLE. En vez de llamar a in.get()/in.read() por cada paquete se lee
+// un bloque grande y los paquetes se recorren directamente en memoria.
+class RLEBlockReader {
+	std::istream& m_in;
+	std::vector<unsigned char> m_buf; // Bloque leido del archivo
+	std::size_t m_pos;                // Siguiente byte por consumir dentro de m_buf
+	std::size_t m_len;                // Cantidad de bytes validos en m_buf
+	std::uint64_t m_base;             // Posicion de m_buf[0] contando desde donde empezo la lectura
+
+public:
+	explicit RLEBlockReader(std::istream& in) : m_in(in), m_buf(rle_block_size), m_pos(0), m_len(0), m_base(0) {}
+
+	// Garantiza que haya al menos n bytes disponibles, retorna false si el archivo se acaba antes
+	bool require(std::size_t n) {
+		if (m_len - m_pos >= n)
+			return true;
+		// Se mueve lo que queda al inicio del bloque y se completa con otra lectura
+		std::size_t rest = m_len - m_pos;
+		std::memmove(m_buf.data(), m_buf.data() + m_pos, rest);
+		m_base += m_pos;
+		m_pos = 0;
+		m_len = rest;
+		if (m_in.good()) {
+			m_in.read((char*)m_buf.data() + m_len, m_buf.size() - m_len);
+			m_len += (std::size_t)m_in.gcount();
+		}
+		return m_len >= n;
+	}
+
+	const unsigned char* data() const { return m_buf.data() + m_pos; }
+	void advance(std::size_t n) { m_pos += n; }
+	std::uint64_t position() const { return m_base + m_pos; } // Bytes consumidos desde el inicio de la lectura
+};
+
+// Misma interfaz que RLEBlockReader, pero sobre datos que ya estan en memoria
+class RLEMemoryReader {
+	const unsigned char* m_begin;
+	const unsigned char* m_cur;
+	const unsigned char* m_end;
+
+public:
+	RLEMemoryReader(const unsigned char* data, std::size_t size) : m_begin(data), m_cur(data), m_end(data + size) {}
+
+	bool require(std::size_t n) const { return (std::size_t)(m_end - m_cur) >= n; }
+	const unsigned char* data() const { return m_cur; }
+	void advance(std::size_t n) { m_cur += n; }
+	std::uint64_t position() const { return (std::uint64_t)(m_cur - m_begin); }
+};
+
+// Repite el pixel que ya esta en dst[0..BPP) hasta completar count pixeles.
+// Cada copia duplica lo ya escrito, asi las copias son anchas en vez de pixel por pixel
+template <int BPP> inline void expand_run(unsigned char* dst, const unsigned char* pixel, unsigned long count) {
+	if (BPP == 1) {
+		std::memset(dst, pixel[0], count);
+		return;
+	}
+	if (BPP == 4) {
+		std::uint32_t v;
+		std::memcpy(&v, pixel, 4);
+		for (unsigned long i = 0; i < count; i++) // El compilador lo convierte en stores vectoriales
+			std::memcpy(dst + i * 4, &v, 4);
+		return;
+	}
+	std::memcpy(dst, pixel, BPP);
+	unsigned long total = count * BPP;
+	unsigned long done = BPP;
+	while (done < total) {
+		unsigned long n = done < total - done ? done : total - done;
+		std::memcpy(dst + done, dst, n);
+		done += n;
+	}
+}
+
+// Decodifica paquetes RLE hasta llenar pixelcount pixeles en dst. BPP es conocido en tiempo de compilacion.
+// skip: pixeles del primer paquete que pertenecen a filas anteriores y no se escriben.
+// clip: el ultimo paquete puede pasarse de pixelcount (para bandas de una imagen ya validada por un
+// pre-escaneo); si es false pasarse es un error, como en la imagen completa.
+// resume: si no es nullptr y el ultimo paquete se corto, ese paquete no se consume y en *resume queda el skip
+// con el que hay que llamar de nuevo para seguir (sirve para decodificar fila por fila); si no, queda 0
+template <int BPP, class Reader>
+bool decode_rle(Reader& src, unsigned char* dst, unsigned long pixelcount, unsigned long skip = 0, bool clip = false,
+                unsigned long* resume = nullptr) {
+	if (resume)
+		*resume = 0;
+	unsigned long currentpixel = 0;
+	std::uint64_t packets = 0;      // Paquetes consumidos, para los contadores
+	std::uint64_t packet_bytes = 0; // Bytes de esos paquetes
+	auto count_stats = [&]() {
+		tga_stats_add(TGA_STAT_PACKETS_DECODED, packets);
+		tga_stats_add(TGA_STAT_RLE_PACKET_BYTES, packet_bytes);
+		tga_stats_add(TGA_STAT_RLE_PIXEL_BYTES, (std::uint64_t)currentpixel * BPP);
+	};
+	while (currentpixel < pixelcount) {
+		if (!src.require(1 + BPP)) {
+			tga_log() << "an error occured while reading the data\n";
+			return false;
+		}
+		const unsigned char* p = src.data();
+		unsigned char chunkheader = p[0];
+		unsigned long packet = (chunkheader & 0x7F) + 1; // Cantidad de pixeles del paquete
+		if (skip >= packet) {
+			tga_log() << "an error occured while reading the data\n";
+			return false;
+		}
+		unsigned long count = packet - skip;
+		bool cut = false; // El paquete sigue despues de pixelcount
+		if (currentpixel + count > pixelcount) {
+			if (!clip) {
+				tga_log() << "Too many pixels read\n";
+				return false;
+			}
+			count = pixelcount - currentpixel;
+			cut = true;
+		}
+		std::size_t nbytes = 1 + BPP; // Bytes del paquete
+		if (chunkheader < 128) { // Raw packet: los pixeles se copian de una sola vez
+			nbytes = 1 + packet * BPP;
+			if (!src.require(nbytes)) {
+				tga_log() << "an error occured while reading the header\n";
+				return false;
+			}
+			std::memcpy(dst, src.data() + 1 + skip * BPP, count * BPP);
+		} else { // Run-length packet: un solo pixel que se repite count veces
+			expand_run<BPP>(dst, p + 1, count);
+		}
+		if (cut && resume) { // Se deja el paquete sin consumir para la siguiente llamada
+			*resume = skip + count;
+			currentpixel += count;
+			count_stats();
+			return true;
+		}
+		src.advance(nbytes);
+		packets++;
+		packet_bytes += nbytes;
+		skip = 0;
+		dst += count * BPP;
+		currentpixel += count;
+	}
+	count_stats();
+	return true;
+}
+
+// Llama a decode_rle<BPP>() segun el valor de bytespp conocido en tiempo de ejecucion
+template <class Reader>
+bool decode_rle(int bytespp, Reader& src, unsigned char* dst, unsigned long pixelcount, unsigned long skip = 0,
+                bool clip = false, unsigned long* resume = nullptr) {
+	switch (bytespp) {
+	case 1:
+		return decode_rle<1>(src, dst, pixelcount, skip, clip, resume);
+	case 2: // Indices de 16 bits y pixeles de 15/16 bits, antes de expandirlos
+		return decode_rle<2>(src, dst, pixelcount, skip, clip, resume);
+	case 3:
+		return decode_rle<3>(src, dst, pixelcount, skip, clip, resume);
+	case 4:
+		return decode_rle<4>(src, dst, pixelcount, skip, clip, resume);
+	}
+	return false;
+}
+
+// Deteccion de repeticiones para el codificador RLE. Se comparan 16 bytes de la fila contra los mismos
+// 16 bytes desplazados un pixel, asi se sabe de una sola vez que pixeles son iguales a su siguiente.
+template <int BPP> struct RLEScan {
+	static const int ppc = 16 / BPP;              // Pixeles que se comparan por bloque de 16 bytes
+	static const unsigned full = (1u << ppc) - 1; // Mascara con los ppc bits encendidos
+
+	// Bit j encendido si el pixel j es igual al pixel j + 1. Lee los bytes [0, 16 + BPP) de p
+	static unsigned eq_mask(const unsigned char* p) {
+#if defined(__SSE2__)
+		__m128i a = _mm_loadu_si128((const __m128i*)p);
+		__m128i b = _mm_loadu_si128((const __m128i*)(p + BPP));
+		unsigned m = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(a, b));
+#else
+		unsigned m = 0;
+		for (int k = 0; k < 16; k++)
+			m |= (unsigned)(p[k] == p[k + BPP]) << k;
+#endif
+		if (BPP == 1)
+			return m;
+		// Un pixel es igual solo si sus BPP bytes lo son; el resultado queda en el primer bit de cada pixel
+		unsigned r = m;
+		for (int t = 1; t < BPP; t++)
+			r &= m >> t;
+		unsigned out = 0;
+		for (int j = 0; j < ppc; j++)
+			out |= ((r >> (j * BPP)) & 1u) << j;
+		return out;
+	}
+
+	static bool eq(const unsigned char* src, int j) {
+		const unsigned char* p = src + j * BPP;
+		for (int t = 0; t < BPP; t++)
+			if (p[t] != p[t + BPP])
+				return false;
+		return true;
+	}
+
+	// Se puede usar eq_mask() en el pixel j sin leer fuera de la fila de n pixeles
+	static bool simd_ok(int j, int n) { return (j + 1) * BPP + 16 <= n * BPP; }
+
+	// Primer pixel j en [i, lim) distinto de su siguiente, o lim. Requiere lim < n
+	static int next_diff(const unsigned char* src, int i, int lim, int n) {
+		int j = i;
+		for (; j + ppc <= lim && simd_ok(j, n); j += ppc) {
+			unsigned m = ~eq_mask(src + j * BPP) & full;
+			if (m)
+				return j + __builtin_ctz(m);
+		}
+		while (j < lim && eq(src, j))
+			j++;
+		return j;
+	}
+
+	// Un Run-length packet solo vale la pena si ahorra bytes respecto a seguir en el Raw packet:
+	// con 1 byte por pixel hacen falta 3 pixeles iguales, con 3 o 4 bytes basta con 2
+	static const int min_run = (BPP == 1) ? 3 : 2;
+
+	static bool starts_run(const unsigned char* src, int j, int n) {
+		if (j + min_run > n)
+			return false;
+		for (int k = 0; k < min_run - 1; k++)
+			if (!eq(src, j + k))
+				return false;
+		return true;
+	}
+
+	// Primer pixel j en [i, lim) donde empieza un Run-length packet, o lim. Requiere lim <= n
+	static int next_run(const unsigned char* src, int i, int lim, int n) {
+		const int step = ppc - (min_run - 2); // El ultimo bit no se puede combinar con el siguiente bloque
+		int j = i;
+		for (; j + ppc <= lim && simd_ok(j, n); j += step) {
+			unsigned m = eq_mask(src + j * BPP);
+			if (min_run == 3)
+				m &= m >> 1;
+			m &= (1u << step) - 1;
+			if (m)
+				return j + __builtin_ctz(m);
+		}
+		while (j < lim && !starts_run(src, j, n))
+			j++;
+		return j;
+	}
+};
+
+// Codifica una fila de n pixeles y agrega los paquetes al final de out. Los paquetes nunca cruzan filas
+// (asi lo recomienda la especificacion TGA 2.0)
+template <int BPP> void encode_rle_row(const unsigned char* src, int n, std::vector<unsigned char>& out) {
+	const int max_chunk_length = 128; // Cantidad maxima de pixeles por paquete 0x7F + 0x1
+	std::size_t start = out.size();
+	std::uint64_t packets = 0;
+	int i = 0;
+	for (; i < n; packets++) {
+		if (RLEScan<BPP>::starts_run(src, i, n)) { // Run-length packet
+			int lim = std::min(n - 1, i + max_chunk_length - 1);
+			int run_length = RLEScan<BPP>::next_diff(src, i, lim, n) - i + 1;
+			out.push_back((unsigned char)(run_length + 128 - 1));
+			out.insert(out.end(), src + i * BPP, src + (i + 1) * BPP);
+			i += run_length;
+		} else { // Raw packet: llega hasta donde empieza la siguiente repeticion que valga la pena
+			int lim = std::min(n, i + max_chunk_length);
+			int run_length = RLEScan<BPP>::next_run(src, i + 1, lim, n) - i;
+			out.push_back((unsigned char)(run_length - 1));
+			out.insert(out.end(), src + i * BPP, src + (i + run_length) * BPP);
+			i += run_length;
+		}
+	}
+	tga_stats_add(TGA_STAT_PACKETS_ENCODED, packets);
+	tga_stats_add(TGA_STAT_RLE_PACKET_BYTES, out.size() - start);
+	tga_stats_add(TGA_STAT_RLE_PIXEL_BYTES, (std::uint64_t)n * BPP);
+}
+
+// Llama a encode_rle_row<BPP>() segun el valor de bytespp conocido en tiempo de ejecucion
+inline void encode_rle_row(int bytespp, const unsigned char* src, int n, std::vector<unsigned char>& out) {
+	switch (bytespp) {
+	case 1:
+		encode_rle_row<1>(src, n, out);
+		break;
+	case 3:
+		encode_rle_row<3>(src, n, out);
+		break;
+	case 4:
+		encode_rle_row<4>(src, n, out);
+		break;
+	}
+}
+
+#endif //__TGARLE_H__
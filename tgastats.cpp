@@ -0,0 +1,75 @@
+#include "tgastats.h"
+#include <cstdio>
+#include <fstream>
+#include <iostream> // std::cerr
+
+std::atomic<bool> tga_stats_flag(false);
+std::atomic<std::uint64_t> tga_stats_values[TGA_STAT_COUNT];
+
+namespace {
+
+std::atomic<int> log_level(TGA_LOG_INFO);
+
+// Stream sin buffer: todo lo que se escribe se descarta. Uno por hilo, porque escribir en el cambia su estado
+std::ostream& null_stream() {
+    thread_local std::ostream null(nullptr);
+    return null;
+}
+
+const char* const stat_names[TGA_STAT_COUNT] = {
+    "files_read",      "files_written",    "bytes_read", "bytes_written", "packets_decoded", "packets_encoded",
+    "rle_pixel_bytes", "rle_packet_bytes", "decodes",    "decode_ns",     "encodes",         "encode_ns",
+    "flips",           "flip_ns",          "scales",     "scale_ns",      "allocations",     "allocated_bytes",
+    "rows_reencoded",  "rows_reused",      "mipmaps",    "mipmap_ns",
+};
+
+} // namespace
+
+void tga_set_log_level(TGALogLevel level) { log_level = level; }
+
+TGALogLevel tga_get_log_level() { return (TGALogLevel)log_level.load(std::memory_order_relaxed); }
+
+std::ostream& tga_log(TGALogLevel level) {
+    if (level != TGA_LOG_NONE && level <= tga_get_log_level())
+        return std::cerr;
+    return null_stream();
+}
+
+void tga_stats_enable(bool on) { tga_stats_flag = on; }
+
+void tga_stats_reset() {
+    for (std::atomic<std::uint64_t>& v : tga_stats_values)
+        v = 0;
+}
+
+std::uint64_t tga_stats_get(TGAStat stat) { return tga_stats_values[stat].load(std::memory_order_relaxed); }
+
+const char* tga_stat_name(TGAStat stat) { return stat_names[stat]; }
+
+double tga_stats_rle_ratio() {
+    std::uint64_t packets = tga_stats_get(TGA_STAT_RLE_PACKET_BYTES);
+    return packets ? (double)tga_stats_get(TGA_STAT_RLE_PIXEL_BYTES) / packets : 0.0;
+}
+
+std::string tga_stats_json() {
+    std::string json = "{";
+    char buf[64];
+    for (int i = 0; i < TGA_STAT_COUNT; i++) {
+        std::snprintf(buf, sizeof(buf), "\"%s\":%llu,", stat_names[i],
+                      (unsigned long long)tga_stats_get((TGAStat)i));
+        json += buf;
+    }
+    std::snprintf(buf, sizeof(buf), "\"rle_ratio\":%.4f}", tga_stats_rle_ratio());
+    json += buf;
+    return json;
+}
+
+bool tga_stats_dump_json(const char* filename) {
+    std::ofstream out(filename);
+    if (!out.is_open()) {
+        tga_log() << "can't open file " << filename << "\n";
+        return false;
+    }
+    out << tga_stats_json() << "\n";
+    return out.good();
+}
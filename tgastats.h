@@ -0,0 +1,97 @@
+#ifndef __TGASTATS_H__
+#define __TGASTATS_H__
+
+#include <atomic>  // Para utilizar std::atomic
+#include <chrono>  // Para utilizar std::chrono::steady_clock
+#include <cstdint> // Para utilizar std::uint64_t
+#include <ostream> // Para utilizar std::ostream
+#include <string>
+
+// Mensajes de diagnostico de la libreria. Por defecto se escribe todo en std::cerr, como siempre; al cargar
+// miles de texturas conviene bajar el nivel a TGA_LOG_ERRORS (sin el "WxH/bpp" de cada lectura) o a TGA_LOG_NONE
+enum TGALogLevel {
+	TGA_LOG_NONE,   // No se escribe nada
+	TGA_LOG_ERRORS, // Solo los errores
+	TGA_LOG_INFO    // Errores y datos de cada imagen leida
+};
+
+void tga_set_log_level(TGALogLevel level);
+TGALogLevel tga_get_log_level();
+
+// Stream donde escribir un mensaje de ese nivel: std::cerr, o un stream que descarta todo si el nivel esta apagado
+std::ostream& tga_log(TGALogLevel level = TGA_LOG_ERRORS);
+
+// Contadores de la instrumentacion. Los *_NS son nanosegundos acumulados (de todos los hilos)
+enum TGAStat {
+	TGA_STAT_FILES_READ,
+	TGA_STAT_FILES_WRITTEN,
+	TGA_STAT_BYTES_READ,    // Bytes de archivos .tga leidos (header incluido)
+	TGA_STAT_BYTES_WRITTEN, // Bytes de archivos .tga escritos (header y footer incluidos)
+	TGA_STAT_PACKETS_DECODED,
+	TGA_STAT_PACKETS_ENCODED,
+	TGA_STAT_RLE_PIXEL_BYTES,  // Bytes de pixeles que pasaron por el codificador o el decodificador RLE
+	TGA_STAT_RLE_PACKET_BYTES, // Bytes de paquetes RLE correspondientes (sin comprimir / esto = compresion)
+	TGA_STAT_DECODES,          // Imagenes (o bandas/regiones) RLE decodificadas
+	TGA_STAT_DECODE_NS,
+	TGA_STAT_ENCODES,
+	TGA_STAT_ENCODE_NS,
+	TGA_STAT_FLIPS,
+	TGA_STAT_FLIP_NS,
+	TGA_STAT_SCALES, // scale() y tga_resample()
+	TGA_STAT_SCALE_NS,
+	TGA_STAT_ALLOCATIONS, // Buffers de pixeles pedidos al allocator de las imagenes
+	TGA_STAT_ALLOCATED_BYTES,
+	TGA_STAT_ROWS_REENCODED, // Imagenes con track_changes(): filas que se codificaron de nuevo al escribir
+	TGA_STAT_ROWS_REUSED,    // y filas que se copiaron de la codificacion anterior
+	TGA_STAT_MIPMAPS,        // Cadenas armadas con TGAMipChain::build()
+	TGA_STAT_MIPMAP_NS,
+	TGA_STAT_COUNT
+};
+
+// La instrumentacion viene apagada: mientras lo este cada punto de medicion solo lee un bool
+void tga_stats_enable(bool on = true);
+void tga_stats_reset(); // Pone todos los contadores en 0
+std::uint64_t tga_stats_get(TGAStat stat);
+const char* tga_stat_name(TGAStat stat); // Nombre del contador en el JSON, p. ej. "bytes_read"
+double tga_stats_rle_ratio();            // Bytes de pixeles / bytes de paquetes, 0 si no hubo RLE
+// Todos los contadores como un objeto JSON, mas "rle_ratio"
+std::string tga_stats_json();
+bool tga_stats_dump_json(const char* filename);
+
+// Estado interno de la instrumentacion, usar las funciones de arriba
+extern std::atomic<bool> tga_stats_flag;
+extern std::atomic<std::uint64_t> tga_stats_values[TGA_STAT_COUNT];
+
+inline bool tga_stats_enabled() { return tga_stats_flag.load(std::memory_order_relaxed); }
+
+inline void tga_stats_add(TGAStat stat, std::uint64_t n) {
+	if (tga_stats_enabled())
+		tga_stats_values[stat].fetch_add(n, std::memory_order_relaxed);
+}
+
+// Mide el tiempo desde que se crea hasta que se destruye y lo suma a time_stat (y 1 a count_stat).
+// Si la instrumentacion esta apagada al crearlo no se lee el reloj
+class TGAStatTimer {
+	TGAStat m_count_stat;
+	TGAStat m_time_stat;
+	bool m_on;
+	std::chrono::steady_clock::time_point m_start;
+
+public:
+	TGAStatTimer(TGAStat count_stat, TGAStat time_stat)
+	    : m_count_stat(count_stat), m_time_stat(time_stat), m_on(tga_stats_enabled()) {
+		if (m_on)
+			m_start = std::chrono::steady_clock::now();
+	}
+	~TGAStatTimer() {
+		if (!m_on)
+			return;
+		auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_start);
+		tga_stats_values[m_count_stat].fetch_add(1, std::memory_order_relaxed);
+		tga_stats_values[m_time_stat].fetch_add((std::uint64_t)ns.count(), std::memory_order_relaxed);
+	}
+	TGAStatTimer(const TGAStatTimer&) = delete;
+	TGAStatTimer& operator=(const TGAStatTimer&) = delete;
+};
+
+#endif //__TGASTATS_H__
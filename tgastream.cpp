@@ -0,0 +1,202 @@
+#include "tgastream.h"
+#include "tgaformat.h"
+#include "tgakernels.h"
+#include "tgarle.h"
+#include "tgastats.h"
+
+TGAStreamWriter::TGAStreamWriter() : m_width(0), m_height(0), m_bytespp(0), m_rle(false), m_rows(0) {}
+
+TGAStreamWriter::~TGAStreamWriter() {}
+
+bool TGAStreamWriter::open(const char* filename, int w, int h, int bpp, bool rle) {
+    if (m_out.is_open())
+        m_out.close();
+    if (w <= 0 || h <= 0 || w > 0xFFFF || h > 0xFFFF ||
+        (bpp != TGAImage::GRAYSCALE && bpp != TGAImage::RGB && bpp != TGAImage::RGBA)) {
+        tga_log() << "bad bpp (or width/height) value\n";
+        return false;
+    }
+    m_out.open(filename, std::ios::binary);
+    if (!m_out.is_open()) {
+        tga_log() << "can't open file " << filename << "\n";
+        return false;
+    }
+    m_width = w;
+    m_height = h;
+    m_bytespp = bpp;
+    m_rle = rle;
+    m_rows = 0;
+    m_buf.clear();
+    std::size_t row_bytes = (std::size_t)w * bpp;
+    if (rle)
+        m_buf.reserve(rle_flush_size + row_bytes + row_bytes / 128 + 1);
+
+    // Las filas llegan de arriba hacia abajo, asi que el archivo siempre es TOP_LEFT
+    TGA_Header header = tga_make_header(w, h, bpp, rle, TGAImage::TOP_LEFT);
+    m_out.write((char*)&header, sizeof(header));
+    if (!m_out.good()) {
+        m_out.close();
+        tga_log() << "can't dump the tga file\n";
+        return false;
+    }
+    return true;
+}
+
+bool TGAStreamWriter::flush() {
+    m_out.write((char*)m_buf.data(), m_buf.size());
+    m_buf.clear();
+    if (!m_out.good()) {
+        tga_log() << "can't dump the tga file\n";
+        return false;
+    }
+    return true;
+}
+
+bool TGAStreamWriter::write_row(const unsigned char* row) {
+    return write_rows(row, 1);
+}
+
+bool TGAStreamWriter::write_rows(const unsigned char* rows, int n) {
+    if (!m_out.is_open())
+        return false;
+    if (n < 0 || n > m_height - m_rows) {
+        tga_log() << "too many rows\n";
+        return false;
+    }
+    std::size_t row_bytes = (std::size_t)m_width * m_bytespp;
+    if (!m_rle) { // std::ofstream ya tiene su propio buffer, las filas se escriben directamente
+        m_out.write((const char*)rows, n * row_bytes);
+        if (!m_out.good()) {
+            tga_log() << "can't unload raw data\n";
+            return false;
+        }
+        m_rows += n;
+        return true;
+    }
+    // Los paquetes nunca cruzan filas, asi que cada fila se codifica por separado
+    TGAStatTimer timer(TGA_STAT_ENCODES, TGA_STAT_ENCODE_NS);
+    for (int i = 0; i < n; i++) {
+        encode_rle_row(m_bytespp, rows + i * row_bytes, m_width, m_buf);
+        if (m_buf.size() >= rle_flush_size && !flush())
+            return false;
+    }
+    m_rows += n;
+    return true;
+}
+
+bool TGAStreamWriter::write_rows(const TGAImage& band) {
+    if (band.get_width() != m_width || band.get_bytespp() != m_bytespp) {
+        tga_log() << "bad band size\n";
+        return false;
+    }
+    return write_rows(band.buffer(), band.get_height());
+}
+
+bool TGAStreamWriter::finish() {
+    if (!m_out.is_open())
+        return false;
+    if (m_rows != m_height) {
+        tga_log() << "missing rows: " << m_rows << " of " << m_height << "\n";
+        m_out.close();
+        return false;
+    }
+    if (!flush())
+        return false;
+    m_out.write((char*)developer_area_ref, sizeof(developer_area_ref));
+    m_out.write((char*)extension_area_ref, sizeof(extension_area_ref));
+    m_out.write((char*)footer, sizeof(footer));
+    if (!m_out.good()) {
+        tga_log() << "can't dump the tga file\n";
+        m_out.close();
+        return false;
+    }
+    tga_stats_add(TGA_STAT_FILES_WRITTEN, 1);
+    tga_stats_add(TGA_STAT_BYTES_WRITTEN, (std::uint64_t)m_out.tellp());
+    m_out.close();
+    return true;
+}
+
+TGAStreamReader::TGAStreamReader() : m_width(0), m_height(0), m_bytespp(0), m_descriptor(0), m_rows(0), m_skip(0) {}
+
+TGAStreamReader::~TGAStreamReader() {}
+
+void TGAStreamReader::close() {
+    m_src.reset();
+    if (m_in.is_open())
+        m_in.close();
+}
+
+bool TGAStreamReader::open(const char* filename) {
+    close();
+    m_in.open(filename, std::ios::binary);
+    if (!m_in.is_open()) {
+        tga_log() << "can't open file " << filename << "\n";
+        return false;
+    }
+    TGA_Header header;
+    m_in.read((char*)&header, sizeof(header));
+    if (!m_in.good()) {
+        close();
+        tga_log() << "an error occured while reading the header\n";
+        return false;
+    }
+    m_width = header.width;
+    m_height = header.height;
+    m_bytespp = header.bitsperpixel / 8;
+    m_descriptor = (std::uint8_t)header.imagedescriptor;
+    if (m_width <= 0 || m_height <= 0 ||
+        (m_bytespp != TGAImage::GRAYSCALE && m_bytespp != TGAImage::RGB && m_bytespp != TGAImage::RGBA)) {
+        close();
+        tga_log() << "bad bpp (or width/height) value\n";
+        return false;
+    }
+    bool rle = header.datatypecode == 10 || header.datatypecode == 11;
+    if (!rle && header.datatypecode != 2 && header.datatypecode != 3) {
+        close();
+        tga_log() << "unknown file format " << (int)header.datatypecode << "\n";
+        return false;
+    }
+    m_in.ignore(tga_data_offset(header) - sizeof(header));
+    if (rle)
+        m_src.reset(new RLEBlockReader(m_in));
+    m_row.resize((std::size_t)m_width * m_bytespp);
+    m_rows = 0;
+    m_skip = 0;
+    tga_stats_add(TGA_STAT_BYTES_READ, tga_data_offset(header));
+    return true;
+}
+
+const unsigned char* TGAStreamReader::next_row(int* y) {
+    if (!m_in.is_open() || m_rows >= m_height)
+        return nullptr;
+    if (m_src) {
+        TGAStatTimer timer(TGA_STAT_DECODES, TGA_STAT_DECODE_NS);
+        std::uint64_t before = m_src->position();
+        if (!decode_rle(m_bytespp, *m_src, m_row.data(), m_width, m_skip, true, &m_skip)) {
+            close();
+            tga_log() << "an error occured while reading the data\n";
+            return nullptr;
+        }
+        tga_stats_add(TGA_STAT_BYTES_READ, m_src->position() - before);
+        if (m_rows == m_height - 1 && m_skip) { // El ultimo paquete se pasa del final de la imagen
+            close();
+            tga_log() << "Too many pixels read\n";
+            return nullptr;
+        }
+    } else {
+        m_in.read((char*)m_row.data(), m_row.size());
+        if (!m_in.good()) {
+            close();
+            tga_log() << "an error occured while reading the data\n";
+            return nullptr;
+        }
+        tga_stats_add(TGA_STAT_BYTES_READ, m_row.size());
+    }
+    if (m_descriptor & 0x10)
+        tga_reverse_pixels(m_row.data(), m_width, m_bytespp);
+    if (y)
+        *y = (m_descriptor & 0x20) ? m_rows : m_height - 1 - m_rows;
+    if (++m_rows == m_height)
+        tga_stats_add(TGA_STAT_FILES_READ, 1);
+    return m_row.data();
+}
@@ -0,0 +1,87 @@
+#ifndef __TGASTREAM_H__
+#define __TGASTREAM_H__
+
+#include <fstream> // Para utilizar std::ifstream y std::ofstream
+#include <memory>  // Para utilizar std::unique_ptr
+#include <vector>
+#include "tgaimage.h"
+
+class RLEBlockReader;
+
+// Escritor de .tga fila por fila, para imagenes que no entran en memoria (mosaicos de gigapixeles, etc.).
+// El header se escribe en open(), las filas se codifican a medida que llegan (de arriba hacia abajo, el archivo
+// queda con origen TOP_LEFT) y finish() agrega el footer. La memoria usada no depende de la altura de la imagen
+class TGAStreamWriter {
+protected:
+	std::ofstream m_out;
+	std::vector<unsigned char> m_buf; // Paquetes RLE pendientes de volcar al archivo
+	int m_width;
+	int m_height;
+	int m_bytespp;
+	bool m_rle;
+	int m_rows; // Filas recibidas hasta ahora
+
+	bool flush();
+
+public:
+	TGAStreamWriter();
+	// Si no se llamo a finish() el archivo queda incompleto (sin todas las filas o sin footer)
+	~TGAStreamWriter();
+	TGAStreamWriter(const TGAStreamWriter&) = delete;
+	TGAStreamWriter& operator=(const TGAStreamWriter&) = delete;
+
+	// w y h pueden llegar a 65535 (el maximo del formato)
+	bool open(const char* filename, int w, int h, int bpp, bool rle = true);
+	// Una fila de get_width() pixeles, con los bytes en el mismo orden que TGAImage::buffer()
+	bool write_row(const unsigned char* row);
+	// n filas seguidas (una banda)
+	bool write_rows(const unsigned char* rows, int n);
+	// Todas las filas de band, que tiene que tener el mismo ancho y bytes por pixel que el archivo
+	bool write_rows(const TGAImage& band);
+	// Verifica que se hayan escrito todas las filas, agrega el footer y cierra el archivo
+	bool finish();
+
+	bool is_open() const { return m_out.is_open(); }
+	int get_width() const { return m_width; }
+	int get_height() const { return m_height; }
+	int get_bytespp() const { return m_bytespp; }
+	int rows_written() const { return m_rows; }
+};
+
+// Lector de .tga fila por fila (sin comprimir o con RLE), con memoria proporcional a una fila.
+// Las filas se entregan en el orden en que estan en el archivo; next_row() indica a que fila de la imagen
+// corresponde cada una (contando desde arriba, como en TGAImage). Si el archivo guarda los pixeles de derecha
+// a izquierda, cada fila ya se entrega invertida
+class TGAStreamReader {
+protected:
+	std::ifstream m_in;
+	std::unique_ptr<RLEBlockReader> m_src; // Solo con RLE
+	std::vector<unsigned char> m_row;
+	int m_width;
+	int m_height;
+	int m_bytespp;
+	int m_descriptor;     // imagedescriptor del header (orientacion)
+	int m_rows;           // Filas entregadas hasta ahora
+	unsigned long m_skip; // Pixeles del paquete actual que ya se entregaron en filas anteriores
+
+public:
+	TGAStreamReader();
+	~TGAStreamReader();
+	TGAStreamReader(const TGAStreamReader&) = delete;
+	TGAStreamReader& operator=(const TGAStreamReader&) = delete;
+
+	bool open(const char* filename);
+	void close();
+	// Siguiente fila del archivo (valida hasta la proxima llamada). Retorna nullptr al terminar o si hay un
+	// error; si y no es nullptr ahi queda la fila de la imagen que corresponde
+	const unsigned char* next_row(int* y = nullptr);
+
+	bool is_open() const { return m_in.is_open(); }
+	int get_width() const { return m_width; }
+	int get_height() const { return m_height; }
+	int get_bytespp() const { return m_bytespp; }
+	int get_descriptor() const { return m_descriptor; }
+	int rows_read() const { return m_rows; }
+};
+
+#endif //__TGASTREAM_H__
@@ -0,0 +1,43 @@
+#ifndef __TGATHREADS_H__
+#define __TGATHREADS_H__
+
+#include <atomic> // Para utilizar std::atomic
+#include <thread> // Para utilizar std::thread
+#include <vector>
+
+// Utilidades internas para repartir trabajo entre hilos
+
+// Cantidad de hilos a usar: si n <= 0 se usan todos los nucleos disponibles
+inline int tga_resolve_threads(int n) {
+	if (n > 0)
+		return n;
+	unsigned hw = std::thread::hardware_concurrency();
+	return hw ? (int)hw : 1;
+}
+
+// Llama a fn(i) para cada i en [0, count) usando hasta nthreads hilos (el hilo actual tambien trabaja).
+// Los indices se reparten dinamicamente, asi un hilo que termina antes toma el siguiente trabajo
+template <class F> void tga_parallel_for(int count, int nthreads, F fn) {
+	nthreads = tga_resolve_threads(nthreads);
+	if (nthreads > count)
+		nthreads = count;
+	if (nthreads <= 1) {
+		for (int i = 0; i < count; i++)
+			fn(i);
+		return;
+	}
+	std::atomic<int> next(0);
+	auto worker = [&]() {
+		for (int i = next++; i < count; i = next++)
+			fn(i);
+	};
+	std::vector<std::thread> threads;
+	threads.reserve(nthreads - 1);
+	for (int t = 1; t < nthreads; t++)
+		threads.emplace_back(worker);
+	worker();
+	for (std::thread& th : threads)
+		th.join();
+}
+
+#endif //__TGATHREADS_H__
@@ -0,0 +1,110 @@
+#ifndef __TGAVIEW_H__
+#define __TGAVIEW_H__
+
+#include <cstddef> // Para utilizar std::ptrdiff_t
+#include "tgaimage.h"
+
+// Pixel empaquetado con el tamanio exacto del formato (a diferencia de TGAColor, que siempre ocupa 8 bytes
+// y guarda bytespp en cada color). Los campos estan en el mismo orden que en el archivo .tga (BGRA)
+template <int BPP> struct TGAPixel;
+
+template <> struct TGAPixel<TGAImage::GRAYSCALE> {
+	std::uint8_t v;
+
+	static TGAPixel from(const TGAColor& c) { return { c.raw[0] }; }
+	TGAColor to_color() const { return TGAColor(v, 1); }
+};
+
+template <> struct TGAPixel<TGAImage::RGB> {
+	std::uint8_t b, g, r;
+
+	static TGAPixel from(const TGAColor& c) { return { c.b, c.g, c.r }; }
+	TGAColor to_color() const { return TGAColor(r, g, b, 255); }
+};
+
+template <> struct TGAPixel<TGAImage::RGBA> {
+	std::uint8_t b, g, r, a;
+
+	static TGAPixel from(const TGAColor& c) { return { c.b, c.g, c.r, c.a }; }
+	TGAColor to_color() const { return TGAColor(r, g, b, a); }
+};
+
+static_assert(sizeof(TGAPixel<TGAImage::GRAYSCALE>) == 1, "TGAPixel<GRAYSCALE> tiene que ocupar 1 byte");
+static_assert(sizeof(TGAPixel<TGAImage::RGB>) == 3, "TGAPixel<RGB> tiene que ocupar 3 bytes");
+static_assert(sizeof(TGAPixel<TGAImage::RGBA>) == 4, "TGAPixel<RGBA> tiene que ocupar 4 bytes");
+
+// Rango de pixeles contiguos (una fila o parte de ella), se puede recorrer con un for de rango
+template <class P> struct TGASpan {
+	P* data;
+	int size;
+
+	P& operator[](int i) const { return data[i]; }
+	P* begin() const { return data; }
+	P* end() const { return data + size; }
+};
+
+// Vista tipada sobre los pixeles de una imagen, con bytes por pixel conocidos en tiempo de compilacion.
+// El acceso a pixeles y filas NO verifica limites: los limites se verifican una sola vez al crear la vista
+// (o una subvista) y luego se recorren filas completas. get()/set() de TGAImage siguen siendo el camino
+// seguro para accesos sueltos. La vista no es duenia de los pixeles, la imagen tiene que seguir existiendo
+template <TGAImage::Format F> class TGAImageView {
+public:
+	typedef TGAPixel<F> Pixel;
+	static const int bytespp = F;
+
+protected:
+	Pixel* m_data;           // Pixel (0, 0) de la vista
+	int m_width;             // Ancho en pixeles
+	int m_height;            // Altura en pixeles
+	std::ptrdiff_t m_stride; // Pixeles entre una fila y la siguiente (puede ser mayor que m_width)
+
+public:
+	TGAImageView() : m_data(nullptr), m_width(0), m_height(0), m_stride(0) {}
+
+	TGAImageView(Pixel* data, int w, int h, std::ptrdiff_t stride)
+	    : m_data(data), m_width(w), m_height(h), m_stride(stride) {}
+
+	// Vista sobre toda la imagen; si la imagen no tiene el formato F la vista queda vacia (is_valid() == false)
+	explicit TGAImageView(TGAImage& img) : TGAImageView() {
+		if (img.buffer() && img.get_bytespp() == F) {
+			m_data = (Pixel*)img.buffer();
+			m_width = img.get_width();
+			m_height = img.get_height();
+			m_stride = m_width;
+		}
+	}
+
+	bool is_valid() const { return m_data != nullptr; }
+	int get_width() const { return m_width; }
+	int get_height() const { return m_height; }
+	std::ptrdiff_t get_stride() const { return m_stride; }
+
+	// Acceso sin verificacion de limites
+	Pixel* row(int y) const { return m_data + y * m_stride; }
+	TGASpan<Pixel> row_span(int y) const { return { row(y), m_width }; }
+	Pixel& operator()(int x, int y) const { return m_data[y * m_stride + x]; }
+
+	bool contains(int x, int y, int w, int h) const {
+		return x >= 0 && y >= 0 && w >= 0 && h >= 0 && x + w <= m_width && y + h <= m_height;
+	}
+
+	// Subvista de w x h pixeles desde (x, y); se verifica aqui una sola vez, si no cabe queda vacia
+	TGAImageView subview(int x, int y, int w, int h) const {
+		if (!m_data || !contains(x, y, w, h))
+			return TGAImageView();
+		return TGAImageView(&(*this)(x, y), w, h, m_stride);
+	}
+
+	// Llena toda la vista con un color
+	void fill(Pixel p) const {
+		for (int y = 0; y < m_height; y++)
+			for (Pixel& q : row_span(y))
+				q = p;
+	}
+};
+
+typedef TGAImageView<TGAImage::GRAYSCALE> TGAImageViewGray;
+typedef TGAImageView<TGAImage::RGB> TGAImageViewRGB;
+typedef TGAImageView<TGAImage::RGBA> TGAImageViewRGBA;
+
+#endif //__TGAVIEW_H__